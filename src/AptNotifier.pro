@@ -10,33 +10,29 @@ TARGET = AptNotifier
 TEMPLATE = app
 
 
+include(model/model.pri)
+
 SOURCES += main.cpp\
-    model/appointment.cpp \
-    model/calendar.cpp \
-    model/calendardb.cpp \
     view/calendardbview.cpp \
     view/inputbox.cpp \
+    view/pixmapcache.cpp \
+    view/calendarlistmodel.cpp \
+    view/agendamodel.cpp \
+    view/agendaview.cpp \
     view/toaster/toaster.cpp \
     view/toaster/toastmanager.cpp \
-    model/logger.cpp \
-    model/aptcache.cpp \
-    model/httpdownloader.cpp \
-    model/icsparser.cpp \
     view/toaster/aptbundle.cpp \
     view/toaster/aptdisplaywidget.cpp
 
 HEADERS  += \
-    model/appointment.h \
-    model/calendar.h \
-    model/calendardb.h \
     view/calendardbview.h \
     view/inputbox.h \
+    view/pixmapcache.h \
+    view/calendarlistmodel.h \
+    view/agendamodel.h \
+    view/agendaview.h \
     view/toaster/toaster.h \
     view/toaster/toastmanager.h \
-    model/logger.h \
-    model/aptcache.h \
-    model/httpdownloader.h \
-    model/icsparser.h \
     view/toaster/aptbundle.h \
     view/toaster/aptdisplaywidget.h
 
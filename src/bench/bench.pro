@@ -0,0 +1,4 @@
+# Benchmark tools. See the README for how to run them.
+
+TEMPLATE = subdirs
+SUBDIRS = mockicsserver refreshbench hotpathbench
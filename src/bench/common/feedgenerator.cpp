@@ -0,0 +1,46 @@
+#include "feedgenerator.h"
+
+#include <cstdlib>
+
+QByteArray FeedGenerator::generate(int feedId, int generation, const QDateTime& base, const Options& options) {
+    // Every (feed, generation) pair gets its own deterministic random sequence
+    srand(feedId*7919 + generation);
+
+    QDateTime utcBase = base.toUTC();
+    QDateTime firstMinute = utcBase.addSecs(60 - utcBase.time().second()).addMSecs(-utcBase.time().msec());
+    QByteArray modified = stamp(utcBase);
+
+    QByteArray ics;
+    ics.reserve(options.events*256 + 256);
+    ics += "BEGIN:VCALENDAR\r\nVERSION:2.0\r\nPRODID:-//AptNotifier//Benchmark//EN\r\n";
+    ics += "X-WR-CALNAME:Benchmark feed " + QByteArray::number(feedId) + "\r\n";
+
+    for (int i = 0; i < options.events; ++i) {
+        QDateTime start;
+        if (i < options.upcoming)
+            start = firstMinute.addSecs(60*i);
+        else
+            start = firstMinute.addSecs(60*60 + 15*60*(rand() % (30*24*4)));
+        QDateTime end = start.addSecs(15*60*(1 + rand() % 8));
+
+        ics += "BEGIN:VEVENT\r\n";
+        ics += "UID:bench-" + QByteArray::number(feedId) + "-" + QByteArray::number(i) + "\r\n";
+        ics += "DTSTART:" + stamp(start) + "\r\n";
+        ics += "DTEND:" + stamp(end) + "\r\n";
+        ics += "LAST-MODIFIED:" + modified + "\r\n";
+        ics += "SUMMARY:Synthetic event " + QByteArray::number(i) + " \\, generation "
+                + QByteArray::number(generation) + "\r\n";
+        if (rand() < options.recurringRatio*RAND_MAX)
+            ics += "RRULE:FREQ=WEEKLY;COUNT=10\r\n";
+        if (rand() < options.reminderRatio*RAND_MAX)
+            ics += "BEGIN:VALARM\r\nACTION:DISPLAY\r\nTRIGGER:-PT1M\r\nEND:VALARM\r\n";
+        ics += "END:VEVENT\r\n";
+    }
+
+    ics += "END:VCALENDAR\r\n";
+    return ics;
+}
+
+QByteArray FeedGenerator::stamp(const QDateTime& dt) {
+    return dt.toUTC().toString("yyyyMMdd'T'hhmmss'Z'").toLatin1();
+}
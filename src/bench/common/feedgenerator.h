@@ -0,0 +1,41 @@
+#ifndef FEEDGENERATOR_H
+#define FEEDGENERATOR_H
+
+#include <QDateTime>
+#include <QByteArray>
+
+/**
+  * Generates synthetic ICS feeds for the benchmark tools. The output only depends
+  * on the feed ID, the generation and the options, so a server and a benchmark
+  * driver can produce identical feeds independently.
+  * \author Pieter De Decker
+  */
+class FeedGenerator
+{
+public:
+    struct Options {
+        Options() : events(500), recurringRatio(0.2), reminderRatio(0.5), upcoming(5) {}
+
+        /** Number of VEVENTs per feed. */
+        int events;
+
+        /** Fraction of events that carry an RRULE. */
+        double recurringRatio;
+
+        /** Fraction of events that carry a VALARM with a TRIGGER. */
+        double reminderRatio;
+
+        /** Number of events that start on the minute boundaries following
+          * 'base', one per minute. Used to measure notification timing. */
+        int upcoming;
+    };
+
+    /** Generates a feed. Events are laid out relative to 'base'; feeds with a
+      * different generation have different LAST-MODIFIED stamps. */
+    static QByteArray generate(int feedId, int generation, const QDateTime& base, const Options& options);
+private:
+    /** Formats a UTC timestamp the way ICS files do. */
+    static QByteArray stamp(const QDateTime& dt);
+};
+
+#endif // FEEDGENERATOR_H
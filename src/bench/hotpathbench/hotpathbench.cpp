@@ -0,0 +1,194 @@
+#include "hotpathbench.h"
+
+#include "model/logger.h"
+#include "model/aptcache.h"
+#include "model/calendar.h"
+#include "model/icsparser.h"
+#include "model/appointment.h"
+#include "view/toaster/toaster.h"
+#include "view/toaster/aptbundle.h"
+#include "view/pixmapcache.h"
+#include "../common/feedgenerator.h"
+#include <QtTest>
+
+HotPathBench::HotPathBench()
+    : _maxEvents(1000000), _calendar(NULL), _sink(0)
+{
+}
+
+void HotPathBench::initTestCase() {
+    Logger::instance()->initialize();
+    _base = QDateTime::currentDateTime();
+    _calendar = new Calendar(1, "http://127.0.0.1:8080/feed/1.ics", "#3366cc");
+    _calendars.add(_calendar);
+
+    QByteArray maxEvents = qgetenv("HOTPATHBENCH_MAXEVENTS");
+    if (!maxEvents.isEmpty())
+        _maxEvents = maxEvents.toInt();
+}
+
+void HotPathBench::cleanupTestCase() {
+    qDeleteAll(_caches);
+    _caches.clear();
+    _feeds.clear();
+    _calendars.take(_calendar->id());
+    delete _calendar;
+
+    // The toasters filled it; its pixmaps can't outlive the QApplication
+    PixmapCache::instance()->clear();
+    Logger::instance()->shutdown();
+}
+
+void HotPathBench::addScales() {
+    QTest::addColumn<int>("events");
+    for (int events = 100; events <= _maxEvents; events *= 10)
+        QTest::newRow(QByteArray::number(events)) << events;
+}
+
+const QByteArray& HotPathBench::feed(int events) {
+    QMap<int, QByteArray>::iterator it = _feeds.find(events);
+    if (it == _feeds.end()) {
+        FeedGenerator::Options options;
+        options.events = events;
+        it = _feeds.insert(events, FeedGenerator::generate(1, 0, _base, options));
+    }
+    return *it;
+}
+
+AptCache* HotPathBench::cache(int events) {
+    AptCache*& result = _caches[events];
+    if (!result) {
+        result = ICSParser(feed(events)).readAppointments();
+        result->updateOngoingApts();
+    }
+    return result;
+}
+
+QList<QByteArray> HotPathBench::eventBlocks(int events) {
+    const QByteArray& data = feed(events);
+    QList<QByteArray> blocks;
+    int beginPos = data.indexOf("BEGIN:VEVENT");
+    while (beginPos != -1) {
+        int endPos = data.indexOf("END:VEVENT", beginPos);
+        if (endPos == -1)
+            break;
+        blocks.append(QByteArray::fromRawData(data.constData() + beginPos, endPos - beginPos));
+        beginPos = data.indexOf("BEGIN:VEVENT", endPos + 10);
+    }
+    return blocks;
+}
+
+void HotPathBench::parserScan_data() {
+    addScales();
+}
+
+void HotPathBench::parserScan() {
+    QFETCH(int, events);
+    const QByteArray& data = feed(events);
+
+    QBENCHMARK {
+        ICSParser parser(data);
+        _sink += parser.checksum();
+    }
+}
+
+void HotPathBench::readAppointments_data() {
+    addScales();
+}
+
+void HotPathBench::readAppointments() {
+    QFETCH(int, events);
+    ICSParser parser(feed(events));
+
+    QBENCHMARK {
+        AptCache* result = parser.readAppointments();
+        _sink += result->appointments()->size();
+        delete result;
+    }
+}
+
+void HotPathBench::appointmentParse_data() {
+    addScales();
+}
+
+void HotPathBench::appointmentParse() {
+    QFETCH(int, events);
+    QList<QByteArray> blocks = eventBlocks(events);
+
+    QBENCHMARK {
+        foreach (const QByteArray& block, blocks) {
+            Appointment apt(block);
+            _sink += apt.isValid();
+        }
+    }
+}
+
+void HotPathBench::updateOngoingApts_data() {
+    addScales();
+}
+
+void HotPathBench::updateOngoingApts() {
+    QFETCH(int, events);
+    AptCache* aptCache = cache(events);
+
+    QBENCHMARK {
+        _sink += aptCache->updateOngoingApts().size();
+    }
+}
+
+void HotPathBench::reminderLookup_data() {
+    addScales();
+}
+
+void HotPathBench::reminderLookup() {
+    QFETCH(int, events);
+    const QMultiMap<QDateTime, Appointment>* reminders = cache(events)->reminders();
+
+    // The minutes of the coming day, truncated like Calendar does
+    QList<QDateTime> minutes;
+    QDateTime minute = _base.addSecs(-_base.time().second()).addMSecs(-_base.time().msec());
+    for (int i = 0; i < 24*60; ++i)
+        minutes.append(minute.addSecs(60*i));
+
+    QBENCHMARK {
+        foreach (const QDateTime& now, minutes) {
+            QMultiMap<QDateTime, Appointment>::const_iterator it = reminders->constFind(now);
+            while (it != reminders->constEnd() && it.key() == now) {
+                ++_sink;
+                ++it;
+            }
+        }
+    }
+}
+
+void HotPathBench::toasterAppend_data() {
+    addScales();
+}
+
+void HotPathBench::toasterAppend() {
+    QFETCH(int, events);
+    AptBundle bundle(_calendar->id(), "Event Reminder", cache(events)->appointments()->values());
+
+    QBENCHMARK {
+        Toaster toaster(&_calendars);
+        toaster.appendBundle(bundle);
+    }
+}
+
+void HotPathBench::toasterNavigation_data() {
+    addScales();
+}
+
+void HotPathBench::toasterNavigation() {
+    QFETCH(int, events);
+    Toaster toaster(&_calendars);
+    toaster.appendBundle(AptBundle(_calendar->id(), "Event Reminder", cache(events)->appointments()->values()));
+    QMetaObject::invokeMethod(&toaster, "nextSlide");
+
+    QBENCHMARK {
+        QMetaObject::invokeMethod(&toaster, "nextSlide");
+        QMetaObject::invokeMethod(&toaster, "prevSlide");
+    }
+}
+
+QTEST_MAIN(HotPathBench)
@@ -0,0 +1,80 @@
+#ifndef HOTPATHBENCH_H
+#define HOTPATHBENCH_H
+
+#include "model/calendarregistry.h"
+#include <QMap>
+#include <QList>
+#include <QObject>
+#include <QDateTime>
+#include <QByteArray>
+class AptCache;
+class Calendar;
+
+/**
+  * QBENCHMARK cases for the code that runs on every refresh, every notification
+  * tick and every toaster slide. Each case runs on synthetic feeds of 100 up to
+  * 1M events; HOTPATHBENCH_MAXEVENTS lowers the upper limit on small machines.
+  * Feeds and caches are built once per scale and shared between cases.
+  * \author Pieter De Decker
+  */
+class HotPathBench : public QObject
+{
+    Q_OBJECT
+public:
+    HotPathBench();
+private:
+    /** Adds one row per scale to the current data table. */
+    void addScales();
+
+    /** Synthetic feed with 'events' events, generated on first use. */
+    const QByteArray& feed(int events);
+
+    /** Appointment cache read from feed(events), built on first use. */
+    AptCache* cache(int events);
+
+    /** The VEVENT blocks of feed(events), as views on the feed. */
+    QList<QByteArray> eventBlocks(int events);
+
+    QDateTime _base;
+    int _maxEvents;
+    Calendar* _calendar;
+    CalendarRegistry _calendars;      // Holds _calendar, for the toasters
+    QMap<int, QByteArray> _feeds;
+    QMap<int, AptCache*> _caches;
+
+    /** Results are added here so the compiler can't drop the measured work. */
+    qint64 _sink;
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    /** ICSParser construction, which computes the checksum and the calendar properties. */
+    void parserScan_data();
+    void parserScan();
+
+    /** ICSParser::readAppointments(). */
+    void readAppointments_data();
+    void readAppointments();
+
+    /** Appointment parsing on its own, one VEVENT at a time. */
+    void appointmentParse_data();
+    void appointmentParse();
+
+    /** AptCache::updateOngoingApts() in its steady state, as on every notification tick. */
+    void updateOngoingApts_data();
+    void updateOngoingApts();
+
+    /** Looking up the reminders of a minute, as Calendar does on every tick. */
+    void reminderLookup_data();
+    void reminderLookup();
+
+    /** Appending a bundle of all appointments to a toaster. */
+    void toasterAppend_data();
+    void toasterAppend();
+
+    /** Moving back and forth between two slides of a toaster holding all appointments. */
+    void toasterNavigation_data();
+    void toasterNavigation();
+};
+
+#endif // HOTPATHBENCH_H
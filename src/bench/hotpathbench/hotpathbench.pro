@@ -0,0 +1,28 @@
+# QTestLib benchmarks of the parser, cache and toaster hot paths.
+
+QT       += core gui network testlib
+
+TARGET = hotpathbench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../../model/model.pri)
+
+SOURCES += hotpathbench.cpp \
+    ../common/feedgenerator.cpp \
+    ../../view/pixmapcache.cpp \
+    ../../view/toaster/toaster.cpp \
+    ../../view/toaster/aptbundle.cpp \
+    ../../view/toaster/aptdisplaywidget.cpp
+
+HEADERS += \
+    hotpathbench.h \
+    ../common/feedgenerator.h \
+    ../../view/pixmapcache.h \
+    ../../view/toaster/toaster.h \
+    ../../view/toaster/aptbundle.h \
+    ../../view/toaster/aptdisplaywidget.h
+
+RESOURCES += \
+    ../../resources.qrc
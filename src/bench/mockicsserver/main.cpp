@@ -0,0 +1,81 @@
+#include "mockicsserver.h"
+
+#include <cstdio>
+#include <QTimer>
+#include <QStringList>
+#include <QHostAddress>
+#include <QCoreApplication>
+
+static int usage() {
+    fprintf(stderr, "Usage: mockicsserver [--port N] [--events N] [--recurring R] [--reminders R]\n"
+                    "                     [--upcoming N] [--latency MS] [--failures R]\n"
+                    "                     [--no-etags] [--change-interval SECS]\n");
+    return 1;
+}
+
+/** Usage: mockicsserver [--port N] [--events N] [--recurring R] [--reminders R]
+  *                      [--upcoming N] [--latency MS] [--failures R]
+  *                      [--no-etags] [--change-interval SECS] */
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    MockIcsServer::Config config;
+    quint16 port = 8080;
+
+    QStringList args = QCoreApplication::arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        QString arg = args[i];
+        if (arg == "--no-etags") {
+            config.etags = false;
+            continue;
+        }
+
+        if (i + 1 == args.size()) {
+            fprintf(stderr, "Option %s needs a value\n", qPrintable(arg));
+            return usage();
+        }
+        QString value = args[++i];
+
+        bool ok = false;
+        if (arg == "--port")
+            port = value.toUShort(&ok);
+        else if (arg == "--events")
+            config.feed.events = value.toInt(&ok);
+        else if (arg == "--recurring")
+            config.feed.recurringRatio = value.toDouble(&ok);
+        else if (arg == "--reminders")
+            config.feed.reminderRatio = value.toDouble(&ok);
+        else if (arg == "--upcoming")
+            config.feed.upcoming = value.toInt(&ok);
+        else if (arg == "--latency")
+            config.latencyMs = value.toInt(&ok);
+        else if (arg == "--failures")
+            config.failureRate = value.toDouble(&ok);
+        else if (arg == "--change-interval")
+            config.changeInterval = value.toInt(&ok);
+        else {
+            fprintf(stderr, "Unknown option %s\n", qPrintable(arg));
+            return usage();
+        }
+
+        if (!ok) {
+            fprintf(stderr, "Invalid value %s for %s\n", qPrintable(value), qPrintable(arg));
+            return usage();
+        }
+    }
+
+    MockIcsServer server(config);
+    if (!server.listen(QHostAddress::LocalHost, port)) {
+        fprintf(stderr, "Couldn't listen on port %d: %s\n", port, qPrintable(server.errorString()));
+        return 1;
+    }
+    printf("Serving synthetic feeds at http://127.0.0.1:%d/feed/<id>.ics\n", port);
+    fflush(stdout);
+
+    // Report request counters every 10 seconds
+    QTimer statsTimer;
+    QObject::connect(&statsTimer, SIGNAL(timeout()), &server, SLOT(printStats()));
+    statsTimer.start(10000);
+
+    return a.exec();
+}
@@ -0,0 +1,106 @@
+#include "mockicsserver.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <QTimer>
+#include <QRegExp>
+#include <QTcpSocket>
+
+MockIcsServer::MockIcsServer(const Config& config, QObject* parent)
+    : QTcpServer(parent), _config(config)
+{
+    _startTime = QDateTime::currentDateTime();
+    _requests = 0;
+    _notModified = 0;
+    _failures = 0;
+    connect(this, SIGNAL(newConnection()), this, SLOT(acceptConnections()));
+}
+
+void MockIcsServer::printStats() const {
+    printf("requests=%d not_modified=%d failures=%d\n", _requests, _notModified, _failures);
+    fflush(stdout);
+}
+
+void MockIcsServer::acceptConnections() {
+    while (hasPendingConnections()) {
+        QTcpSocket* socket = nextPendingConnection();
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+void MockIcsServer::readRequest() {
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket)
+        return;
+
+    // Wait until the complete header block has arrived
+    QByteArray pending = socket->property("pending").toByteArray() + socket->readAll();
+    if (!pending.contains("\r\n\r\n")) {
+        socket->setProperty("pending", pending);
+        return;
+    }
+    socket->setProperty("pending", QVariant());
+    ++_requests;
+
+    // Send the response after the configured latency. Closing the connection
+    // marks the end of the body, as in HTTP/1.0.
+    socket->setProperty("response", respond(pending));
+    QTimer* timer = new QTimer(socket);
+    timer->setSingleShot(true);
+    connect(timer, SIGNAL(timeout()), this, SLOT(sendResponse()));
+    timer->start(_config.latencyMs);
+}
+
+void MockIcsServer::sendResponse() {
+    QTimer* timer = qobject_cast<QTimer*>(sender());
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(timer ? timer->parent() : NULL);
+    if (!socket)
+        return;
+
+    socket->write(socket->property("response").toByteArray());
+    socket->disconnectFromHost();
+    timer->deleteLater();
+}
+
+QByteArray MockIcsServer::respond(const QByteArray& request) {
+    QRegExp feedPath("^GET /feed/(\\d+)\\.ics");
+    if (feedPath.indexIn(QString::fromLatin1(request)) == -1)
+        return "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+
+    // Simulate server trouble
+    if (rand() < _config.failureRate*RAND_MAX) {
+        ++_failures;
+        return "HTTP/1.0 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n";
+    }
+
+    int feedId = feedPath.cap(1).toInt();
+    int generation = _startTime.secsTo(QDateTime::currentDateTime()) / std::max(1, _config.changeInterval);
+    QByteArray etag = "\"" + QByteArray::number(feedId) + "-" + QByteArray::number(generation) + "\"";
+
+    QByteArray headers = "HTTP/1.0 200 OK\r\nContent-Type: text/calendar; charset=utf-8\r\n";
+    if (_config.etags) {
+        QRegExp ifNoneMatch("\\r\\nIf-None-Match: *([^\\r]*)\\r\\n", Qt::CaseInsensitive);
+        if (ifNoneMatch.indexIn(QString::fromLatin1(request)) != -1 && ifNoneMatch.cap(1).toLatin1() == etag) {
+            ++_notModified;
+            return "HTTP/1.0 304 Not Modified\r\nETag: " + etag + "\r\n\r\n";
+        }
+        headers += "ETag: " + etag + "\r\n";
+    }
+
+    const QByteArray& body = feed(feedId, generation);
+    return headers + "Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n" + body;
+}
+
+const QByteArray& MockIcsServer::feed(int feedId, int generation) {
+    QPair<int, int> key(feedId, generation);
+    QHash<QPair<int, int>, QByteArray>::iterator it = _feeds.find(key);
+    if (it == _feeds.end()) {
+        _feeds.remove(qMakePair(feedId, generation - 1));
+        QDateTime base = _startTime.addSecs(generation*_config.changeInterval);
+        it = _feeds.insert(key, FeedGenerator::generate(feedId, generation, base, _config.feed));
+    }
+
+    return it.value();
+}
@@ -0,0 +1,64 @@
+#ifndef MOCKICSSERVER_H
+#define MOCKICSSERVER_H
+
+#include "../common/feedgenerator.h"
+#include <QHash>
+#include <QPair>
+#include <QDateTime>
+#include <QTcpServer>
+
+class QTcpSocket;
+
+/**
+  * Minimal HTTP/1.0 server that serves synthetic ICS feeds at /feed/<id>.ics. Feeds
+  * change every 'changeInterval' seconds. Each response can be delayed and can fail
+  * at random, and ETag/If-None-Match support can be switched off.
+  * \author Pieter De Decker
+  */
+class MockIcsServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    struct Config {
+        Config() : latencyMs(0), failureRate(0.0), etags(true), changeInterval(300) {}
+
+        FeedGenerator::Options feed;
+        int latencyMs;
+        double failureRate;
+        bool etags;
+        int changeInterval;
+    };
+
+    MockIcsServer(const Config& config, QObject* parent = 0);
+public slots:
+    /** Prints request counters to stdout. */
+    void printStats() const;
+private slots:
+    /** Accepts new connections. */
+    void acceptConnections();
+
+    /** Reads request data; answers once the request headers are complete. */
+    void readRequest();
+
+    /** Writes a prepared response after its latency timer fired. */
+    void sendResponse();
+private:
+    /** Builds the full HTTP response for a request. */
+    QByteArray respond(const QByteArray& request);
+
+    /** Returns the cached feed for an ID and generation, generating it if needed. */
+    const QByteArray& feed(int feedId, int generation);
+
+    Config _config;
+    QDateTime _startTime;
+
+    /** Generated feeds, keyed by (feed ID, generation). Older generations are dropped. */
+    QHash<QPair<int, int>, QByteArray> _feeds;
+
+    // Statistics
+    int _requests;
+    int _notModified;
+    int _failures;
+};
+
+#endif // MOCKICSSERVER_H
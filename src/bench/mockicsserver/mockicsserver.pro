@@ -0,0 +1,17 @@
+# Local stand-in for calendar servers, used by refreshbench.
+
+QT       += core network
+QT       -= gui
+
+TARGET = mockicsserver
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += main.cpp \
+    mockicsserver.cpp \
+    ../common/feedgenerator.cpp
+
+HEADERS += \
+    mockicsserver.h \
+    ../common/feedgenerator.h
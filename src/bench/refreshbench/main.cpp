@@ -0,0 +1,83 @@
+#include "refreshbench.h"
+
+#include "model/logger.h"
+#include <cstdio>
+#include <QStringList>
+#include <QCoreApplication>
+
+static int usage() {
+    fprintf(stderr, "Usage: refreshbench [--url BASE] [--calendars N] [--rounds N] [--duration SECS]\n"
+                    "                    [--parse-iterations N] [--max-inflight N] [--per-host N]\n"
+                    "                    [--events N] [--recurring R] [--reminders R] [--upcoming N]\n");
+    return 1;
+}
+
+/** Usage: refreshbench [--url BASE] [--calendars N] [--rounds N] [--duration SECS]
+  *                     [--parse-iterations N] [--max-inflight N] [--per-host N]
+  *                     [--events N] [--recurring R] [--reminders R] [--upcoming N]
+  * The feed options must match those passed to mockicsserver. --max-inflight and
+  * --per-host set the FetchScheduler limits. */
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("AptNotifier refreshbench");
+    Logger::instance()->initialize();
+    RefreshBench::Options options;
+
+    QStringList args = QCoreApplication::arguments();
+    for (int i = 1; i < args.size(); i += 2) {
+        QString arg = args[i];
+        if (i + 1 == args.size()) {
+            fprintf(stderr, "Option %s needs a value\n", qPrintable(arg));
+            return usage();
+        }
+        QString value = args[i + 1];
+
+        bool ok = true;
+        if (arg == "--url")
+            options.baseUrl = value;
+        else if (arg == "--calendars")
+            options.calendars = value.toInt(&ok);
+        else if (arg == "--rounds")
+            options.rounds = value.toInt(&ok);
+        else if (arg == "--duration")
+            options.duration = value.toInt(&ok);
+        else if (arg == "--parse-iterations")
+            options.parseIterations = value.toInt(&ok);
+        else if (arg == "--max-inflight")
+            options.maxInFlight = value.toInt(&ok);
+        else if (arg == "--per-host")
+            options.maxPerHost = value.toInt(&ok);
+        else if (arg == "--events")
+            options.feed.events = value.toInt(&ok);
+        else if (arg == "--recurring")
+            options.feed.recurringRatio = value.toDouble(&ok);
+        else if (arg == "--reminders")
+            options.feed.reminderRatio = value.toDouble(&ok);
+        else if (arg == "--upcoming")
+            options.feed.upcoming = value.toInt(&ok);
+        else {
+            fprintf(stderr, "Unknown option %s\n", qPrintable(arg));
+            return usage();
+        }
+
+        if (!ok) {
+            fprintf(stderr, "Invalid value %s for %s\n", qPrintable(value), qPrintable(arg));
+            return usage();
+        }
+    }
+
+    // FetchScheduler asserts on limits below 1
+    if (options.maxInFlight < 1 || options.maxPerHost < 1)
+        return usage();
+
+    int retVal;
+    {
+        RefreshBench bench(options);
+        bench.start();
+        retVal = a.exec();
+    }
+
+    Logger::instance()->shutdown();
+    return retVal;
+}
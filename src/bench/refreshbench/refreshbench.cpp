@@ -0,0 +1,156 @@
+#include "refreshbench.h"
+
+#include "model/calendar.h"
+#include "model/aptcache.h"
+#include "model/icsparser.h"
+#include "model/lockprofiler.h"
+#include <cstdio>
+#include <QTimer>
+#include <algorithm>
+#include <QCoreApplication>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+RefreshBench::RefreshBench(const Options& options)
+    : _options(options)
+{
+    _round = 0;
+    _refreshesThisRound = 0;
+    _totalRefreshes = 0;
+    _roundsMsecs = 0;
+    _parseMsecs = 0;
+    _readMsecs = 0;
+
+    // Only the benchmark triggers refreshes
+    _calDB.setRefreshLimits(24*60*60, 24*60*60, false);
+    connect(&_calDB, SIGNAL(newCalendarAdded(int)), this, SLOT(watchCalendar(int)));
+}
+
+void RefreshBench::start() {
+    FetchScheduler::instance()->setLimits(_options.maxInFlight, _options.maxPerHost);
+    timeParser();
+
+    // Adding the calendars triggers the first round
+    _roundClock.start();
+    for (int i = 0; i < _options.calendars; ++i)
+        _calDB.addCalendar(_options.baseUrl + "/feed/" + QString::number(i) + ".ics", "#000000", false);
+
+    QTimer::singleShot(_options.duration*1000, this, SLOT(finish()));
+}
+
+void RefreshBench::watchCalendar(int id) {
+    Calendar* cal = _calDB.calendar(id);
+    connect(cal, SIGNAL(refreshFinished(int)), this, SLOT(countRefresh(int)));
+    connect(cal, SIGNAL(newOngoingAppointments(int,QList<Appointment>)),
+            this, SLOT(recordOngoing(int,QList<Appointment>)));
+}
+
+void RefreshBench::countRefresh(int) {
+    if (_round >= _options.rounds)
+        return;
+
+    ++_totalRefreshes;
+    if (++_refreshesThisRound < _options.calendars)
+        return;
+
+    // Round complete
+    qint64 elapsed = _roundClock.elapsed();
+    _roundsMsecs += elapsed;
+    printf("round %d: %d refreshes in %lld ms\n", _round, _refreshesThisRound, elapsed);
+    fflush(stdout);
+
+    ++_round;
+    _refreshesThisRound = 0;
+    if (_round < _options.rounds) {
+        _roundClock.start();
+        _calDB.updateCalendars();
+    }
+}
+
+void RefreshBench::recordOngoing(int, const QList<Appointment>& list) {
+    QDateTime now = QDateTime::currentDateTime();
+    foreach (const Appointment& apt, list) {
+        // Appointments that were already running when the feed was loaded
+        // don't say anything about timer accuracy
+        qint64 lateness = (qint64)apt.start().secsTo(now)*1000 + now.time().msec();
+        if (lateness < 60*1000)
+            _latenessMsecs.append(lateness);
+    }
+}
+
+void RefreshBench::finish() {
+    int completedRounds = std::max(1, _round);
+    double seconds = _roundsMsecs/1000.0;
+
+    printf("calendars=%d\n", _options.calendars);
+    printf("events_per_feed=%d\n", _options.feed.events);
+    printf("max_in_flight=%d\n", _options.maxInFlight);
+    printf("max_per_host=%d\n", _options.maxPerHost);
+    printf("rounds_completed=%d\n", _round);
+    printf("refreshes=%d\n", _totalRefreshes);
+    printf("refreshes_per_sec=%.2f\n", seconds > 0 ? _totalRefreshes/seconds : 0.0);
+    printf("avg_round_ms=%.1f\n", (double)_roundsMsecs/completedRounds);
+    printf("parse_ms=%.3f\n", _parseMsecs);
+    printf("read_appointments_ms=%.3f\n", _readMsecs);
+    printf("peak_memory_kb=%ld\n", peakMemoryKb());
+
+    if (!_latenessMsecs.isEmpty()) {
+        qSort(_latenessMsecs);
+        qint64 total = 0;
+        foreach (qint64 lateness, _latenessMsecs)
+            total += lateness;
+        printf("notifications=%d\n", _latenessMsecs.size());
+        printf("notification_lateness_avg_ms=%lld\n", total/_latenessMsecs.size());
+        printf("notification_lateness_p95_ms=%lld\n", _latenessMsecs.at((_latenessMsecs.size() - 1)*95/100));
+        printf("notification_lateness_max_ms=%lld\n", _latenessMsecs.last());
+    } else {
+        printf("notifications=0\n");
+    }
+    printf("lock_profile:\n%s\n", qPrintable(LockProfiler::instance()->report()));
+    fflush(stdout);
+
+    QCoreApplication::quit();
+}
+
+void RefreshBench::timeParser() {
+    QByteArray feed = FeedGenerator::generate(0, 0, QDateTime::currentDateTime(), _options.feed);
+    QElapsedTimer clock;
+    qint64 parseNsecs = 0, readNsecs = 0;
+
+    for (int i = 0; i < _options.parseIterations; ++i) {
+        clock.start();
+        ICSParser parser(feed);
+        parseNsecs += clock.nsecsElapsed();
+
+        clock.start();
+        AptCache* cache = parser.readAppointments();
+        readNsecs += clock.nsecsElapsed();
+        delete cache;
+    }
+
+    int iterations = std::max(1, _options.parseIterations);
+    _parseMsecs = parseNsecs/1e6/iterations;
+    _readMsecs = readNsecs/1e6/iterations;
+}
+
+long RefreshBench::peakMemoryKb() {
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return -1;
+    return (long)(counters.PeakWorkingSetSize/1024);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#ifdef Q_OS_MAC
+    return usage.ru_maxrss/1024;    // Bytes on Mac OS X
+#else
+    return usage.ru_maxrss;         // Kilobytes on Linux
+#endif
+#endif
+}
@@ -0,0 +1,92 @@
+#ifndef REFRESHBENCH_H
+#define REFRESHBENCH_H
+
+#include "model/calendardb.h"
+#include "model/appointment.h"
+#include "model/fetchscheduler.h"
+#include "../common/feedgenerator.h"
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QElapsedTimer>
+
+class Calendar;
+
+/**
+  * Drives a CalendarDB against mockicsserver and reports refresh throughput, parse
+  * time, peak memory use and how late ongoing-appointment notifications arrive.
+  * \author Pieter De Decker
+  */
+class RefreshBench : public QObject
+{
+    Q_OBJECT
+public:
+    struct Options {
+        Options() : baseUrl("http://127.0.0.1:8080"), calendars(50), rounds(5), duration(150), parseIterations(20),
+            maxInFlight(FetchScheduler::DEFAULTMAXINFLIGHT), maxPerHost(FetchScheduler::DEFAULTMAXINFLIGHT) {}
+
+        /** Server root; calendars are fetched from <baseUrl>/feed/<i>.ics. */
+        QString baseUrl;
+        int calendars;
+
+        /** Number of "Update all" rounds used to measure throughput. */
+        int rounds;
+
+        /** Total run time in seconds. Should span a few minute boundaries to
+          * collect notification timings. */
+        int duration;
+
+        /** Number of parses used to time ICSParser on a local copy of a feed. */
+        int parseIterations;
+
+        /** FetchScheduler limits. All feeds live on one host, so the per-host limit
+          * defaults to the global one; otherwise it would cap the throughput. */
+        int maxInFlight;
+        int maxPerHost;
+
+        /** Must match the server's settings for the parse timings to be representative. */
+        FeedGenerator::Options feed;
+    };
+
+    RefreshBench(const Options& options);
+
+    /** Starts the benchmark. The application quits once the report is printed. */
+    void start();
+private slots:
+    /** Hooks up a newly added calendar. */
+    void watchCalendar(int id);
+
+    /** Counts a processed download and starts the next round when all are in. */
+    void countRefresh(int id);
+
+    /** Records how late a batch of ongoing-appointment notifications arrived. */
+    void recordOngoing(int id, const QList<Appointment>& list);
+
+    /** Prints the report and quits. */
+    void finish();
+private:
+    /** Times ICSParser construction and readAppointments on a generated feed. */
+    void timeParser();
+
+    /** Peak resident set size of this process in kilobytes. */
+    static long peakMemoryKb();
+
+    Options _options;
+    CalendarDB _calDB;
+
+    // Throughput
+    QElapsedTimer _roundClock;
+    int _round;
+    int _refreshesThisRound;
+    int _totalRefreshes;
+    qint64 _roundsMsecs;
+
+    // Parser timings
+    double _parseMsecs;
+    double _readMsecs;
+
+    // Notification lateness
+    QList<qint64> _latenessMsecs;
+};
+
+#endif // REFRESHBENCH_H
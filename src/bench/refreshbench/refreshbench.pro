@@ -0,0 +1,21 @@
+# End-to-end refresh benchmark. Run mockicsserver first.
+
+QT       += core network
+QT       -= gui
+
+TARGET = refreshbench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../../model/model.pri)
+
+SOURCES += main.cpp \
+    refreshbench.cpp \
+    ../common/feedgenerator.cpp
+
+HEADERS += \
+    refreshbench.h \
+    ../common/feedgenerator.h
+
+win32:LIBS += -lpsapi
@@ -0,0 +1,21 @@
+# Headless AptNotifier: the model without QtGui. See the README.
+
+QT       += core network
+QT       -= gui
+
+TARGET = aptnotifierd
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../model/model.pri)
+
+SOURCES += main.cpp \
+    notificationprinter.cpp
+
+HEADERS += \
+    notificationprinter.h
+
+CONFIG(debug, debug|release) {
+    DEFINES += DEBUG
+}
@@ -0,0 +1,100 @@
+#include "notificationprinter.h"
+
+#include "model/logger.h"
+#include "model/bodycache.h"
+#include "model/calendardb.h"
+#include "model/queryserver.h"
+#include "model/metricsexporter.h"
+#include "model/flightrecorder.h"
+#include <cstdio>
+#include <QStringList>
+#include <QSocketNotifier>
+#include <QCoreApplication>
+#ifdef Q_OS_UNIX
+#include <csignal>
+#include <unistd.h>
+
+/** SIGINT and SIGTERM write a byte here; the event loop picks it up and quits. */
+static int stopPipe[2];
+
+static void handleStopSignal(int) {
+    char c = 1;
+    ssize_t written = ::write(stopPipe[1], &c, 1);
+    (void)written;
+}
+#endif
+
+static int usage() {
+    fprintf(stderr, "Usage: aptnotifierd [--syslog] [--refresh-limits <minsecs> <maxsecs>]\n"
+                    "                   [--summary-threshold <n>]\n");
+    return 1;
+}
+
+/** Usage: aptnotifierd [--syslog] [--refresh-limits <minsecs> <maxsecs>]
+  *                     [--summary-threshold <n>]
+  * Runs the calendars in the working directory without a GUI. Notifications go to
+  * stdout, or to syslog with --syslog. --refresh-limits changes the saved bounds
+  * of the freshness lifetime of calendars without limits of their own, and
+  * --summary-threshold the saved number of notifications from which the desktop
+  * application shows a summary. SIGINT and SIGTERM shut down cleanly. */
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("aptnotifierd");
+    NotificationPrinter::Output output = NotificationPrinter::Stdout;
+
+    int minRefresh = 0, maxRefresh = 0;
+    int summaryThreshold = 0;
+
+    QStringList args = QCoreApplication::arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        if (args[i] == "--syslog") {
+            output = NotificationPrinter::Syslog;
+        } else if (args[i] == "--refresh-limits" && i + 2 < args.size()) {
+            minRefresh = args[++i].toInt();
+            maxRefresh = args[++i].toInt();
+            if (minRefresh <= 0 || minRefresh > maxRefresh)
+                return usage();
+        } else if (args[i] == "--summary-threshold" && i + 1 < args.size()) {
+            summaryThreshold = args[++i].toInt();
+            if (summaryThreshold <= 0)
+                return usage();
+        } else {
+            return usage();
+        }
+    }
+
+    Logger::instance()->initialize();
+    FlightRecorder::instance()->initialize();
+    BodyCache::instance()->initialize();
+
+#ifdef Q_OS_UNIX
+    if (::pipe(stopPipe) == 0) {
+        QSocketNotifier* stopNotifier = new QSocketNotifier(stopPipe[0], QSocketNotifier::Read, &a);
+        QObject::connect(stopNotifier, SIGNAL(activated(int)), &a, SLOT(quit()));
+        signal(SIGINT, &handleStopSignal);
+        signal(SIGTERM, &handleStopSignal);
+    }
+#endif
+
+    int retVal;
+    {
+        CalendarDB calDB;
+        NotificationPrinter printer(&calDB, output);
+        QueryServer queryServer(&calDB);
+        queryServer.listen();
+        MetricsExporter metricsExporter(&calDB);
+        metricsExporter.start(QString::fromLocal8Bit(qgetenv("APTNOTIFIER_METRICS")));
+        calDB.loadCalendars();
+        if (minRefresh > 0)
+            calDB.setRefreshLimits(minRefresh, maxRefresh);
+        if (summaryThreshold > 0)
+            calDB.setSummaryThreshold(summaryThreshold);
+        retVal = a.exec();
+    }
+
+    // Calendars log while shutting down, so the logger goes last
+    FlightRecorder::instance()->shutdown();
+    Logger::instance()->shutdown();
+    return retVal;
+}
@@ -0,0 +1,72 @@
+#include "notificationprinter.h"
+
+#include "model/calendar.h"
+#include "model/calendardb.h"
+#include <cstdio>
+#include <cassert>
+#include <QDateTime>
+#ifdef Q_OS_UNIX
+#include <syslog.h>
+#endif
+
+NotificationPrinter::NotificationPrinter(CalendarDB* calDB, Output output)
+{
+    assert(calDB);
+    _calDB = calDB;
+    _output = output;
+#ifdef Q_OS_UNIX
+    if (_output == Syslog)
+        openlog("aptnotifierd", LOG_PID, LOG_USER);
+#else
+    _output = Stdout;
+#endif
+
+    connect(_calDB, SIGNAL(newCalendarAdded(int)), this, SLOT(watchCalendar(int)));
+    connect(_calDB, SIGNAL(notificationsDue(QList<Notification>)), this, SLOT(printNotifications(QList<Notification>)));
+}
+
+NotificationPrinter::~NotificationPrinter()
+{
+#ifdef Q_OS_UNIX
+    if (_output == Syslog)
+        closelog();
+#endif
+}
+
+void NotificationPrinter::print(const QString& line, bool warning) {
+#ifdef Q_OS_UNIX
+    if (_output == Syslog) {
+        syslog(warning ? LOG_WARNING : LOG_NOTICE, "%s", line.toUtf8().constData());
+        return;
+    }
+#endif
+
+    QString stamp = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
+    printf("%s %s\n", qPrintable(stamp), line.toUtf8().constData());
+    fflush(stdout);
+}
+
+void NotificationPrinter::watchCalendar(int id) {
+    Calendar* cal = _calDB->calendar(id);
+    assert(cal);
+    connect(cal, SIGNAL(formatNotRecognized(int)), this, SLOT(printFormatError(int)));
+}
+
+void NotificationPrinter::printNotifications(const QList<Notification>& batch) {
+    foreach (const Notification& n, batch) {
+        Calendar* cal = _calDB->calendar(n.calendarId);
+        QString calName = cal ? cal->name() : QString::number(n.calendarId);
+        QString kind = (n.kind == Notification::Ongoing) ? "now" : "reminder";
+        bool escalated = n.apt.priority() == Appointment::Escalated;
+        if (escalated)
+            kind = "important " + kind;
+        print(kind + ": " + n.apt.summary() + " (" + n.apt.timeString() + ") [" + calName + "]", escalated);
+    }
+}
+
+void NotificationPrinter::printFormatError(int id) {
+    Calendar* cal = _calDB->calendar(id);
+    if (!cal)
+        return;
+    print("error: calendar " + cal->url().toString() + " could not be fetched or recognized", true);
+}
@@ -0,0 +1,39 @@
+#ifndef NOTIFICATIONPRINTER_H
+#define NOTIFICATIONPRINTER_H
+
+#include "model/notificationdispatcher.h"
+#include <QObject>
+#include <QString>
+class CalendarDB;
+
+/**
+  * Headless counterpart of the toaster: writes notifications and calendar errors
+  * as single lines to stdout, or to syslog where available.
+  * \author Pieter De Decker
+  */
+class NotificationPrinter : public QObject
+{
+    Q_OBJECT
+public:
+    enum Output { Stdout, Syslog };
+
+    NotificationPrinter(CalendarDB* calDB, Output output);
+    ~NotificationPrinter();
+private:
+    /** Writes one line to the chosen output. 'warning' raises the syslog priority. */
+    void print(const QString& line, bool warning = false);
+
+    CalendarDB* _calDB;
+    Output _output;
+private slots:
+    /** Subscribes to the format errors of a newly added calendar. */
+    void watchCalendar(int id);
+
+    /** Prints one line per notification. */
+    void printNotifications(const QList<Notification>& batch);
+
+    /** Reports a calendar that couldn't be fetched or recognized. */
+    void printFormatError(int id);
+};
+
+#endif // NOTIFICATIONPRINTER_H
@@ -2,7 +2,12 @@
 
 #include "model/logger.h"
 #include "model/calendar.h"
+#include "model/bodycache.h"
 #include "model/calendardb.h"
+#include "model/queryserver.h"
+#include "model/metricsexporter.h"
+#include "model/flightrecorder.h"
+#include "view/pixmapcache.h"
 #include "view/calendardbview.h"
 #include <QFile>
 #include <QMutex>
@@ -19,10 +24,24 @@ int main(int argc, char *argv[])
 #endif
     QCoreApplication::setApplicationVersion("v0.01");
     Logger::instance()->initialize();
+    FlightRecorder::instance()->initialize();
+    BodyCache::instance()->initialize();
 
-    CalendarDB calDB;
-    CalendarDBView calDBView(&calDB);
-    calDBView.hide();
-    
-    return a.exec();
+    int retVal;
+    {
+        CalendarDB calDB;
+        QueryServer queryServer(&calDB);
+        queryServer.listen();
+        MetricsExporter metricsExporter(&calDB);
+        metricsExporter.start(QString::fromLocal8Bit(qgetenv("APTNOTIFIER_METRICS")));
+        CalendarDBView calDBView(&calDB);
+        calDBView.hide();
+        retVal = a.exec();
+    }
+    PixmapCache::instance()->clear();
+
+    // Calendars log while shutting down, so the logger goes last
+    FlightRecorder::instance()->shutdown();
+    Logger::instance()->shutdown();
+    return retVal;
 }
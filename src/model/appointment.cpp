@@ -1,14 +1,13 @@
 #include "appointment.h"
 
+#include "utf8.h"
 #include "calendar.h"
 #include <cmath>
 #include <cassert>
-#include <QString>
 
-Appointment::Appointment(const QString& input)
+Appointment::Appointment(const QByteArray& rawData)
+    : _priority(Normal)
 {
-    QString rawData = input;
-
     parseStart(rawData);
     parseEnd(rawData);
     parseSummary(rawData);
@@ -18,6 +17,7 @@ Appointment::Appointment(const Appointment& other) {
     _start = other._start;
     _end = other._end;
     _summary = other._summary;
+    _priority = other._priority;
 }
 
 bool Appointment::isDayWide() const {
@@ -98,65 +98,63 @@ QString Appointment::timeString_Regular() const {
         return "Starts " + _start.date().toString(Qt::SystemLocaleShortDate) + " " + _start.time().toString("hh:mm");
 }
 
-void Appointment::parseStart(const QString &rawData)
+void Appointment::parseStart(const QByteArray &rawData)
 {
     // Option 1: the start time is a date/time stamp
     int dtstartPos = rawData.indexOf("DTSTART:");
-    if (dtstartPos != -1) {
-        QString trimmedData = rawData.mid(dtstartPos + 8);
-        trimmedData = trimmedData.left(trimmedData.indexOf("\n"));
-        _start = parseDateTime(trimmedData);
-    }
+    if (dtstartPos != -1)
+        _start = parseDateTime(lineAt(rawData, dtstartPos + 8));
 
     // Option 2: the start time is a date stamp
     dtstartPos = rawData.indexOf("DTSTART;VALUE=DATE:");
-    if (dtstartPos != -1) {
-        QString trimmedData = rawData.mid(dtstartPos + 19);
-        trimmedData = trimmedData.left(trimmedData.indexOf("\n"));
-        QDate date(trimmedData.mid(0, 4).toInt(), trimmedData.mid(4, 2).toInt(), trimmedData.mid(6, 2).toInt());
-        _start = QDateTime(date);
-    }
+    if (dtstartPos != -1)
+        _start = QDateTime(parseDate(lineAt(rawData, dtstartPos + 19)));
 }
 
-void Appointment::parseEnd(const QString &rawData)
+void Appointment::parseEnd(const QByteArray &rawData)
 {
     // Option 1: the end time is a date/time stamp
     int dtendPos = rawData.indexOf("DTEND:");
-    if (dtendPos != -1) {
-        QString trimmedData = rawData.mid(dtendPos + 6);
-        _end = parseDateTime(trimmedData);
-    }
+    if (dtendPos != -1)
+        _end = parseDateTime(lineAt(rawData, dtendPos + 6));
 
     // Option 2: the end time is a date stamp
     dtendPos = rawData.indexOf("DTEND;VALUE=DATE:");
-    if (dtendPos != -1) {
-        QString trimmedData = rawData.mid(dtendPos + 17);
-        trimmedData = trimmedData.left(trimmedData.indexOf("\n"));
-        QDate date(trimmedData.mid(0, 4).toInt(), trimmedData.mid(4, 2).toInt(), trimmedData.mid(6, 2).toInt());
-        _end = QDateTime(date);
-    }
-
+    if (dtendPos != -1)
+        _end = QDateTime(parseDate(lineAt(rawData, dtendPos + 17)));
 }
 
-void Appointment::parseSummary(const QString &rawData) {
+void Appointment::parseSummary(const QByteArray &rawData) {
     // Check if a summary has been given
     int beginPos = rawData.indexOf("SUMMARY:");
     if (beginPos == -1)
         return;
 
     // Parse the summary, taking escape characters into account
-    QString input = rawData.mid(beginPos+8);
-    _summary = input.left(input.indexOf("\n"));
+    _summary = Utf8::decode(lineAt(rawData, beginPos + 8));
     _summary = _summary.replace("\\,", ",");
     _summary = _summary.replace("\\n", "\n");
     _summary = _summary.replace("\\;", ";");
     _summary = _summary.replace("\\\\", "\\");
 }
 
-QDateTime Appointment::parseDateTime(const QString& rawData) {
-    QDate date(rawData.mid(0, 4).toInt(), rawData.mid(4, 2).toInt(), rawData.mid(6, 2).toInt());
+QDateTime Appointment::parseDateTime(const QByteArray& rawData) {
+    QDate date = parseDate(rawData);
     QTime time(rawData.mid(9, 2).toInt(), rawData.mid(11, 2).toInt(), rawData.mid(13, 2).toInt());
 
     QDateTime utcDT(date, time);
     return utcDT.addSecs(60*60*Calendar::getTimeShift());
 }
+
+QDate Appointment::parseDate(const QByteArray& rawData) {
+    return QDate(rawData.mid(0, 4).toInt(), rawData.mid(4, 2).toInt(), rawData.mid(6, 2).toInt());
+}
+
+QByteArray Appointment::lineAt(const QByteArray& rawData, int pos) {
+    const char* data = rawData.constData();
+    int end = pos;
+    while (end < rawData.size() && data[end] != '\r' && data[end] != '\n')
+        ++end;
+
+    return QByteArray::fromRawData(data + pos, end - pos);
+}
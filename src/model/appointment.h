@@ -1,9 +1,9 @@
 #ifndef APPOINTMENT_H
 #define APPOINTMENT_H
 
+#include <QString>
 #include <QDateTime>
-
-class QString;
+#include <QByteArray>
 
 /**
   * Stores details of a calendar event.
@@ -12,11 +12,19 @@ class QString;
 class Appointment
 {
 public:
-    Appointment(const QString& rawData);
+    /** Parses the raw UTF-8 data of a VEVENT. Only the fields that are displayed
+      * are decoded, so 'rawData' may be a view on a larger buffer. */
+    Appointment(const QByteArray& rawData);
     Appointment(const Appointment& other);
 
     bool isValid() const { return _start.isValid() && _end.isValid(); }
 
+    /** How notifications about the appointment are delivered. Decided by the
+      * FilterRules when the calendar builds its cache. */
+    enum Priority { Normal, Muted, Escalated };
+    Priority priority() const { return _priority; }
+    void setPriority(Priority priority) { _priority = priority; }
+
     const QDateTime& start() const { return _start; }
     const QDateTime& end() const { return _end; }
     const QString& summary() const { return _summary; }
@@ -28,20 +36,26 @@ public:
     /** Generates a string representation of the start/end time, relative
       * to the current time. */
     QString timeString() const;
+
+    /** Returns the rest of the line that starts at 'pos', without copying it. The
+      * result stops at the first CR or LF and is only valid while rawData lives. */
+    static QByteArray lineAt(const QByteArray& rawData, int pos);
 private:
     // Time string generation helpers
     QString timeString_DayWide() const;
     QString timeString_Regular() const;
 
     // Parsing helpers
-    void parseStart(const QString& rawData);
-    void parseEnd(const QString& rawData);
-    void parseSummary(const QString& rawData);
-    QDateTime parseDateTime(const QString& rawData);
+    void parseStart(const QByteArray& rawData);
+    void parseEnd(const QByteArray& rawData);
+    void parseSummary(const QByteArray& rawData);
+    QDateTime parseDateTime(const QByteArray& rawData);
+    QDate parseDate(const QByteArray& rawData);
 
     QDateTime _start;
     QDateTime _end;
     QString _summary;
+    Priority _priority;
 };
 
 #endif // APPOINTMENT_H
@@ -1,7 +1,51 @@
 #include "aptcache.h"
 
+#include "metrics.h"
+
+namespace {
+    Gauge appointmentsMetric("aptnotifier_cache_appointments", "Appointments in all calendar caches");
+    Gauge remindersMetric("aptnotifier_cache_reminders", "Pending reminders in all calendar caches");
+    Gauge bytesMetric("aptnotifier_cache_bytes", "Estimated memory used by all calendar caches");
+
+    /** Rough size of a map node or list entry holding an appointment, without its text. */
+    const int ENTRYSIZE = sizeof(QDateTime) + sizeof(Appointment) + 4*sizeof(void*);
+}
+
 AptCache::AptCache()
+    : _countedApts(0), _countedReminders(0), _countedBytes(0), _textBytesPerApt(-1)
+{
+}
+
+AptCache::~AptCache()
 {
+    appointmentsMetric.add(-_countedApts);
+    remindersMetric.add(-_countedReminders);
+    bytesMetric.add(-_countedBytes);
+}
+
+void AptCache::updateMetrics() {
+    int apts = _appointments.size() + _ongoingApts.size();
+    int reminders = _reminders.size();
+
+    // Walking the entries once is enough; the cache only shrinks afterwards
+    if (_textBytesPerApt < 0) {
+        qint64 textBytes = 0;
+        for (QMultiMap<QDateTime, Appointment>::const_iterator it = _appointments.constBegin(); it != _appointments.constEnd(); ++it)
+            textBytes += it->summary().size()*int(sizeof(QChar));
+        foreach (const Appointment& apt, _ongoingApts)
+            textBytes += apt.summary().size()*int(sizeof(QChar));
+        _textBytesPerApt = apts > 0 ? int(textBytes/apts) : 0;
+    }
+
+    // Reminders share their text with the appointments they belong to
+    int bytes = (apts + reminders)*ENTRYSIZE + apts*_textBytesPerApt;
+
+    appointmentsMetric.add(apts - _countedApts);
+    remindersMetric.add(reminders - _countedReminders);
+    bytesMetric.add(bytes - _countedBytes);
+    _countedApts = apts;
+    _countedReminders = reminders;
+    _countedBytes = bytes;
 }
 
 QList<Appointment> AptCache::updateOngoingApts() {
@@ -40,9 +84,10 @@ QList<Appointment> AptCache::updateOngoingApts_CollectNewlyOngoing(QList<Appoint
         }
         // Transfer ongoing appointments to a separate data structure
         else if (apt.start() <= now && now <= apt.end()) {
-            // Add it to the ongoing list and the "new" list
+            // Add it to the ongoing list and, unless it's muted, the "new" list
             allOngoing.push_back(apt);
-            newOngoing.push_back(allOngoing.last());
+            if (apt.priority() != Appointment::Muted)
+                newOngoing.push_back(allOngoing.last());
 
             // Remove it from the appointment list
             it = _appointments.erase(it);
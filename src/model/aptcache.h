@@ -17,6 +17,7 @@ class AptCache
 {
 public:
     AptCache();
+    ~AptCache();
 
     // Getters
     QMultiMap<QDateTime, Appointment>* appointments() { return &_appointments; }
@@ -24,8 +25,13 @@ public:
     QList<Appointment>* ongoingApts() { return &_ongoingApts; }
 
     /** Updates the list of ongoing appointments for the current timestamp. Returns a list
-      * of newly ongoing appointments. */
+      * of newly ongoing appointments, except muted ones. */
     QList<Appointment> updateOngoingApts();
+
+    /** Brings this cache's share of the cache size gauges up to date. The first call
+      * measures the average text size of the appointments, so make it after filling
+      * the cache; later calls only look at the entry counts. */
+    void updateMetrics();
 private:
     /** [HELPER] Removes ongoing appointments that have expired. */
     void updateOngoingApts_RemoveExpired(QList<Appointment>& allOngoing, const QDateTime& now);
@@ -41,6 +47,14 @@ private:
 
     /** Contains all ongoing appointments. */
     QList<Appointment> _ongoingApts;
+
+    /** What this cache last added to the cache size gauges. */
+    int _countedApts;
+    int _countedReminders;
+    int _countedBytes;
+
+    /** Average summary size in bytes, or -1 until updateMetrics() measured it. */
+    int _textBytesPerApt;
 };
 
 #endif // APTCACHE_H
@@ -0,0 +1,203 @@
+#include "bodycache.h"
+
+#include "logger.h"
+#include "fileutil.h"
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QCryptographicHash>
+
+LogCategory BodyCache::CLASSNAME("BodyCache");
+const qint64 BodyCache::DEFAULTMAXSIZE = 64*1024*1024;
+BodyCache BodyCache::instancePtr;
+
+BodyCache::BodyCache()
+{
+    _maxBytes = DEFAULTMAXSIZE;
+    _initialized = false;
+}
+
+BodyCache* BodyCache::instance() {
+    return &instancePtr;
+}
+
+void BodyCache::initialize(const QString& dir, qint64 maxBytes) {
+    _lock.lock();
+    _dir = dir;
+    _maxBytes = maxBytes;
+    if (QDir().mkpath(_dir + "/objects")) {
+        readIndex();
+        _initialized = true;
+    } else {
+        LOG_WARNING(CLASSNAME, NULL, LogMessage("Couldn't create cache directory %1, caching disabled").arg(_dir));
+    }
+    _lock.unlock();
+}
+
+bool BodyCache::lookup(const QUrl& url, QByteArray& body) {
+    _lock.lock();
+    QHash<QString, Entry>::iterator it = _entries.find(url.toString());
+    if (!_initialized || it == _entries.end()) {
+        _lock.unlock();
+        return false;
+    }
+
+    // Objects are named after their hash, so corruption is easy to detect
+    QFile file(objectPath(it->hash));
+    bool ok = file.open(QIODevice::ReadOnly);
+    if (ok) {
+        body = file.readAll();
+        ok = (QCryptographicHash::hash(body, QCryptographicHash::Sha1).toHex() == it->hash);
+    }
+
+    if (ok) {
+        // The new timestamp is persisted with the next index write
+        it->lastUsed = QDateTime::currentDateTime();
+    } else {
+        LOG_WARNING(CLASSNAME, NULL, LogMessage("Dropping unreadable cache entry for %1").arg(url));
+        body.clear();
+        QString key = it.key();
+        removeEntry(key);
+        writeIndex();
+    }
+    _lock.unlock();
+
+    return ok;
+}
+
+bool BodyCache::validators(const QUrl& url, QByteArray& etag, QByteArray& lastModified) {
+    _lock.lock();
+    QHash<QString, Entry>::const_iterator it = _entries.constFind(url.toString());
+    bool found = _initialized && it != _entries.constEnd();
+    if (found) {
+        etag = it->etag;
+        lastModified = it->lastModified;
+    }
+    _lock.unlock();
+
+    return found;
+}
+
+void BodyCache::store(const QUrl& url, const QByteArray& body, const QByteArray& etag, const QByteArray& lastModified) {
+    Entry entry;
+    entry.hash = QCryptographicHash::hash(body, QCryptographicHash::Sha1).toHex();
+    entry.size = body.size();
+    entry.lastUsed = QDateTime::currentDateTime();
+    entry.etag = etag;
+    entry.lastModified = lastModified;
+
+    _lock.lock();
+    if (!_initialized) {
+        _lock.unlock();
+        return;
+    }
+
+    // Identical bodies are only written once. Objects never change after
+    // they've been written, so an existing file can be trusted.
+    QString key = url.toString();
+    QString path = objectPath(entry.hash);
+    if (!QFile::exists(path) && !FileUtil::writeAtomically(path, body)) {
+        _lock.unlock();
+        return;
+    }
+
+    // Point the URL at the new object before cleaning up the previous one. If the
+    // body didn't change, both are the same file and only the validators move.
+    QHash<QString, Entry>::const_iterator previous = _entries.constFind(key);
+    QByteArray previousHash = (previous != _entries.constEnd()) ? previous->hash : QByteArray();
+    _entries.insert(key, entry);
+    if (!previousHash.isEmpty() && previousHash != entry.hash && !isReferenced(previousHash))
+        QFile::remove(objectPath(previousHash));
+
+    evict();
+    writeIndex();
+    _lock.unlock();
+}
+
+QString BodyCache::objectPath(const QByteArray& hash) const {
+    return _dir + "/objects/" + QString(hash);
+}
+
+bool BodyCache::isReferenced(const QByteArray& hash) const {
+    for (QHash<QString, Entry>::const_iterator it = _entries.constBegin(); it != _entries.constEnd(); ++it) {
+        if (it->hash == hash)
+            return true;
+    }
+
+    return false;
+}
+
+void BodyCache::removeEntry(const QString& key) {
+    QByteArray hash = _entries.value(key).hash;
+    _entries.remove(key);
+    if (!isReferenced(hash))
+        QFile::remove(objectPath(hash));
+}
+
+void BodyCache::evict() {
+    // Shared objects only count once towards the total
+    QHash<QByteArray, qint64> objectSizes;
+    for (QHash<QString, Entry>::const_iterator it = _entries.constBegin(); it != _entries.constEnd(); ++it)
+        objectSizes.insert(it->hash, it->size);
+
+    qint64 total = 0;
+    foreach (qint64 size, objectSizes)
+        total += size;
+
+    while (total > _maxBytes && !_entries.isEmpty()) {
+        // Find the least recently used URL
+        QHash<QString, Entry>::const_iterator lru = _entries.constBegin();
+        for (QHash<QString, Entry>::const_iterator it = _entries.constBegin(); it != _entries.constEnd(); ++it) {
+            if (it->lastUsed < lru->lastUsed)
+                lru = it;
+        }
+
+        QString key = lru.key();
+        QByteArray hash = lru->hash;
+        qint64 size = lru->size;
+        LOG_DEBUG(CLASSNAME, NULL, LogMessage("Evicting %1").arg(key));
+        removeEntry(key);
+        if (!isReferenced(hash))
+            total -= size;
+    }
+}
+
+void BodyCache::readIndex() {
+    _entries.clear();
+    QFile file(_dir + "/index");
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    // One entry per line: hash, size, last use, ETag, Last-Modified and URL
+    while (!file.atEnd()) {
+        QList<QByteArray> fields = file.readLine().trimmed().split('\t');
+        if (fields.size() != 6)
+            continue;
+
+        Entry entry;
+        entry.hash = fields[0];
+        entry.size = fields[1].toLongLong();
+        entry.lastUsed = QDateTime::fromTime_t(fields[2].toUInt());
+        entry.etag = QByteArray::fromPercentEncoding(fields[3]);
+        entry.lastModified = QByteArray::fromPercentEncoding(fields[4]);
+        QString key = QString::fromUtf8(QByteArray::fromPercentEncoding(fields[5]));
+
+        // Skip entries whose object went missing
+        if (QFile::exists(objectPath(entry.hash)))
+            _entries.insert(key, entry);
+    }
+
+    LOG_INFO(CLASSNAME, NULL, LogMessage("Loaded %1 cache entries").arg(_entries.size()));
+}
+
+void BodyCache::writeIndex() {
+    QByteArray data;
+    for (QHash<QString, Entry>::const_iterator it = _entries.constBegin(); it != _entries.constEnd(); ++it) {
+        data += it->hash + '\t' + QByteArray::number(it->size) + '\t'
+                + QByteArray::number(it->lastUsed.toTime_t()) + '\t'
+                + it->etag.toPercentEncoding() + '\t' + it->lastModified.toPercentEncoding() + '\t'
+                + it.key().toUtf8().toPercentEncoding() + '\n';
+    }
+
+    FileUtil::writeAtomically(_dir + "/index", data);
+}
@@ -0,0 +1,84 @@
+#ifndef BODYCACHE_H
+#define BODYCACHE_H
+
+#include "logger.h"
+#include <QUrl>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QDateTime>
+#include <QByteArray>
+
+/**
+  * On-disk cache holding the last good response body of every calendar URL, along
+  * with the validators (ETag and Last-Modified) needed for conditional requests.
+  * Bodies are stored once per SHA-1 hash in the 'objects' subdirectory, so
+  * identical feeds share a file. Least recently used URLs are evicted when the
+  * total size exceeds the cap. All writes go through FileUtil::writeAtomically.
+  * All functions in this class are thread-safe.
+  *
+  * \author Pieter De Decker
+  */
+class BodyCache
+{
+private:
+    BodyCache();
+public:
+    static BodyCache* instance();
+
+    /** Loads the index from 'dir'. Must be called before using the cache; until then,
+      * lookups miss and stores are ignored. */
+    void initialize(const QString& dir = "cache", qint64 maxBytes = DEFAULTMAXSIZE);
+
+    /** Fetches the cached body for a URL. Returns false on a miss or if the stored
+      * body doesn't match its hash anymore. */
+    bool lookup(const QUrl& url, QByteArray& body);
+
+    /** Fetches the validators for a URL. Returns false if nothing is cached. */
+    bool validators(const QUrl& url, QByteArray& etag, QByteArray& lastModified);
+
+    /** Stores a freshly downloaded body and its validators, then evicts entries
+      * until the cache fits within its size cap. */
+    void store(const QUrl& url, const QByteArray& body, const QByteArray& etag, const QByteArray& lastModified);
+
+    static const qint64 DEFAULTMAXSIZE;
+private:
+    struct Entry {
+        QByteArray hash;
+        qint64 size;
+        QDateTime lastUsed;
+        QByteArray etag;
+        QByteArray lastModified;
+    };
+
+    /** Returns the path of the object file for a hash. */
+    QString objectPath(const QByteArray& hash) const;
+
+    /** Returns true if another URL still refers to an object. _lock must be held. */
+    bool isReferenced(const QByteArray& hash) const;
+
+    /** Drops an entry and deletes its object if no other URL uses it. _lock must be held. */
+    void removeEntry(const QString& key);
+
+    /** Evicts least recently used entries until the cache fits its cap. _lock must be held. */
+    void evict();
+
+    /** Reads the index file. _lock must be held. */
+    void readIndex();
+
+    /** Writes the index file atomically. _lock must be held. */
+    void writeIndex();
+
+    static LogCategory CLASSNAME;
+    static BodyCache instancePtr;
+
+    QMutex _lock;
+    QString _dir;
+    qint64 _maxBytes;
+    bool _initialized;
+
+    /** Cache entries, keyed by URL. */
+    QHash<QString, Entry> _entries;
+};
+
+#endif // BODYCACHE_H
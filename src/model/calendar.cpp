@@ -1,83 +1,237 @@
 #include "calendar.h"
 
+#include "metrics.h"
 #include "aptcache.h"
 #include "icsparser.h"
+#include "bodycache.h"
+#include "flightrecorder.h"
 #include "appointment.h"
+#include "localfilesource.h"
+#include "notificationdispatcher.h"
 #include <cmath>
 #include <QFile>
 #include <QDebug>
 #include <cassert>
+#include <algorithm>
 #include <QTextStream>
-#include <QMessageBox>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#include <QtConcurrentRun>
 #include <QNetworkReply>
 #include <QNetworkRequest>
 
 short Calendar::timeShift = Calendar::calcTimeShift();
-const short Calendar::IMAGEDIM = 64;
-const char* Calendar::CLASSNAME = "Calendar";
+const int Calendar::SOONTHRESHOLD = 15*60;
+LogCategory Calendar::CLASSNAME("Calendar");
+const QEvent::Type Calendar::MAILBOXEVENT = static_cast<QEvent::Type>(QEvent::registerEventType());
+
+namespace {
+    const int latenessBounds[] = { 1, 5, 10, 50, 100, 500, 1000, 5000 };
+    const int durationBounds[] = { 10, 50, 100, 500, 1000, 5000, 10000, 50000 };
+
+    Counter ongoingMetric("aptnotifier_notifications_ongoing_total", "Appointments reported as newly ongoing");
+    Counter remindersMetric("aptnotifier_notifications_reminders_total", "Reminders that went off");
+    Histogram latenessMetric("aptnotifier_notification_tick_lateness_milliseconds", "How long after its aligned tick a calendar checked its notifications",
+                             latenessBounds, sizeof(latenessBounds)/sizeof(latenessBounds[0]));
+    Histogram checkMetric("aptnotifier_notification_check_duration_microseconds", "Time a calendar spent checking its notifications",
+                          durationBounds, sizeof(durationBounds)/sizeof(durationBounds[0]));
+}
 
-Calendar::Calendar(const QString &url, const QColor &color) {
+// Timers and downloader are children so they follow us to our shard thread
+Calendar::Calendar(int id, const QString &url, const QString &color, const FilterRules* filters) :
+    _id(id), _filters(filters), _nfyTimer(this), _refreshTimer(this), _httpDl(this)
+{
     QByteArray urlArray;
     _url = QUrl::fromEncoded(urlArray.append(url));
     _name = "Untitled Calendar";
     _calChecksum = 0;
+    _lockSite = NULL;
+    _lockAcquiredAt = 0;
+    _refreshStartedAt = 0;
     _color = color;
     _status = NotLoaded;
+    _minRefreshSecs = 60;
+    _maxRefreshSecs = 60;
     _aptCache = new AptCache();
-    buildCalendarImage();
 
     // Wire QObjects
-    connect(&_httpDl, SIGNAL(receivedData(bool,QString*)), this, SLOT(parseNetworkResponse(bool,QString*)));
-    connect(&_nfyTimer, SIGNAL(timeout()), this, SLOT(sendNotifications()));
-    _nfyTimer.setInterval(30000);
+    connect(&_httpDl, SIGNAL(receivedData(bool,QByteArray)), this, SLOT(parseNetworkResponse(bool,QByteArray)));
+    _fileSource = NULL;
+    if (_url.scheme() == "file") {
+        _fileSource = new LocalFileSource(_url.toLocalFile(), this);
+        connect(_fileSource, SIGNAL(receivedData(bool,QByteArray)), this, SLOT(parseNetworkResponse(bool,QByteArray)));
+        connect(_fileSource, SIGNAL(changed()), this, SLOT(update()));
+    }
+    connect(&_nfyTimer, SIGNAL(timeout()), this, SLOT(postNotificationTick()));
     _nfyTimer.setSingleShot(true);
+    connect(&_refreshTimer, SIGNAL(timeout()), this, SLOT(refreshTimerFired()));
+    _refreshTimer.setSingleShot(true);
+    _hasQueuedResponse = false;
+    _updatePending = false;
+    _pendingManual = false;
+    _parsing = false;
 }
 
 Calendar::~Calendar() {
+    // Caches that were built for us but never installed are ours to clean up
+    _parseFuture.waitForFinished();
+    Message msg;
+    while (_mailbox.pop(msg)) {
+        if (msg.type == Message::ParseDone)
+            delete msg.result.cache;
+    }
     delete _aptCache;
 }
 
-void Calendar::update()
+void Calendar::setRefreshLimits(int minSecs, int maxSecs)
 {
-    // Start calendar download asynchronously. After retrieving the
-    // file, parseNetworkResponse will take over.
-    _httpDl.doGet(_url);
-    Logger::instance()->add(CLASSNAME, this, "Update request was filed");
+    assert(0 < minSecs && minSecs <= maxSecs);
+    Message msg(Message::SetRefreshLimits);
+    msg.minSecs = minSecs;
+    msg.maxSecs = maxSecs;
+    post(msg);
+}
+
+void Calendar::update(bool manual)
+{
+    Message msg(Message::Refresh);
+    msg.manual = manual;
+    post(msg);
+}
+
+void Calendar::refreshTimerFired()
+{
+    FlightRecorder::instance()->record(FlightRecorder::TimerFired, this, FlightRecorder::RefreshTimer);
+    update();
+}
+
+void Calendar::postNotificationTick()
+{
+    FlightRecorder::instance()->record(FlightRecorder::TimerFired, this, FlightRecorder::NotificationTimer);
+    post(Message(Message::NotificationTick));
+}
+
+void Calendar::post(const Message& msg)
+{
+    // Only the first message of a batch needs to wake us up
+    if (_mailbox.push(msg))
+        QCoreApplication::postEvent(this, new QEvent(MAILBOXEVENT));
+}
+
+bool Calendar::event(QEvent* e)
+{
+    if (e->type() == MAILBOXEVENT) {
+        drain();
+        return true;
+    }
+
+    return QObject::event(e);
+}
+
+void Calendar::drain()
+{
+    Message msg;
+    int count = 0;
+    while (_mailbox.pop(msg)) {
+        ++count;
+        handleMessage(msg);
+    }
+
+    // Messages that were pushed while we were busy need another wake-up
+    if (_mailbox.consumed(count))
+        QCoreApplication::postEvent(this, new QEvent(MAILBOXEVENT));
 }
 
-void Calendar::drawBorder(QImage &img, int thickness, const QColor &color) {
-    assert(thickness < img.width() && thickness < img.height());
-    fillRectangle(img, 0, 0, img.width(), thickness, color);                               // Top
-    fillRectangle(img, img.width() - thickness, 0, thickness, img.height(), color);        // Right
-    fillRectangle(img, 0, img.height() - thickness, img.width(), thickness, color);        // Bottom
-    fillRectangle(img, 0, 0, thickness, img.height(), color);                              // Left
+void Calendar::handleMessage(Message& msg)
+{
+    switch (msg.type) {
+    case Message::Refresh:
+        handleRefresh(msg.manual);
+        break;
+    case Message::ParseDone:
+        handleParseDone(msg.result);
+        break;
+    case Message::NotificationTick: {
+        // Timers may fire a little early, which shows up as a tick that's almost a full interval late
+        int lateness = NotificationDispatcher::TICKINTERVAL - NotificationDispatcher::msecsToNextTick();
+        latenessMetric.observe(lateness < NotificationDispatcher::TICKINTERVAL/2 ? lateness : 0);
+        sendNotifications();
+        break;
+    }
+    case Message::SetRefreshLimits:
+        _minRefreshSecs = msg.minSecs;
+        _maxRefreshSecs = msg.maxSecs;
+        break;
+    }
+}
+
+void Calendar::handleRefresh(bool manual)
+{
+    // Don't start a new refresh while the previous download is still being parsed
+    if (_parsing) {
+        _updatePending = true;
+        _pendingManual |= manual;
+        return;
+    }
+
+    FlightRecorder::instance()->record(FlightRecorder::RefreshStarted, this, manual);
+    _refreshStartedAt = FlightRecorder::instance()->now();
+
+    // Local files are read right away and watched for changes instead of polled
+    if (_fileSource) {
+        LOG_DEBUG(CLASSNAME, this, "Reading local calendar file");
+        _fileSource->read();
+        return;
+    }
+
+    // A manual refresh replaces the pending automatic one
+    _refreshTimer.stop();
+
+    // On the first update, show the cached copy from a previous session while
+    // the (conditional) download is in progress
+    QByteArray cachedBody;
+    if (status() == NotLoaded && BodyCache::instance()->lookup(_url, cachedBody)) {
+        LOG_DEBUG(CLASSNAME, this, "Loading cached copy");
+        parseNetworkResponse(true, cachedBody);
+    }
+
+    // Start calendar download asynchronously. After retrieving the
+    // file, parseNetworkResponse will take over.
+    FetchScheduler::Priority priority = FetchScheduler::Background;
+    if (manual)
+        priority = FetchScheduler::Manual;
+    else if (hasNotificationsDueSoon())
+        priority = FetchScheduler::ReminderDue;
+    _httpDl.doGet(_url, priority);
+    LOG_DEBUG(CLASSNAME, this, "Update request was filed");
 }
 
 void Calendar::sendNotifications()
 {
-    Logger::instance()->add(CLASSNAME, this, "Checking notifications...");
+    LOG_DEBUG(CLASSNAME, this, "Checking notifications...");
+    QElapsedTimer timer;
+    timer.start();
 
     // First get the ongoing appointment notifications out the door,
     // then process the reminders.
     sendNotifications_Ongoing();
     sendNotifications_Reminders();
+    _aptCache->updateMetrics();
+    checkMetric.observe(int(timer.nsecsElapsed()/1000));
 
-    // Check notifications again in half a minute
-    engageBufferLock("accessing timer");
-    _nfyTimer.start();
-    releaseBufferLock("finished accessing timer");
+    // Check notifications again on the next tick, together with all other calendars
+    _nfyTimer.start(NotificationDispatcher::msecsToNextTick());
 }
 
 void Calendar::sendNotifications_Ongoing()
 {
     // Update the list of ongoing appointments
-    engageBufferLock("updating ongoing appointment list");
     QList<Appointment> newOngoing = _aptCache->updateOngoingApts();
-    releaseBufferLock("updated ongoing appointment list");
 
     // Broadcast new ongoing appointments to observers
     if (newOngoing.size() > 0) {
-        emit newOngoingAppointments(this, newOngoing);
+        ongoingMetric.add(newOngoing.size());
+        emit newOngoingAppointments(_id, newOngoing);
     }
 }
 
@@ -90,7 +244,6 @@ void Calendar::sendNotifications_Reminders()
     // Get the list of reminders that are dated at this minute and
     // erase them from reminder storage
     QList<Appointment> reminders;
-    engageBufferLock("accessing/updating reminders list");
     QMap<QDateTime, Appointment>::iterator it = _aptCache->reminders()->find(now);
 
     // Collect all reminders dated to now
@@ -98,57 +251,67 @@ void Calendar::sendNotifications_Reminders()
         reminders.push_back(*it);
         it = _aptCache->reminders()->erase(it);
     }
-    releaseBufferLock("finished accessing reminders list");
 
     // Broadcast new reminders to observers
-    if (reminders.count() > 0)
-        emit newReminders(this, reminders);
+    if (reminders.count() > 0) {
+        remindersMetric.add(reminders.count());
+        emit newReminders(_id, reminders);
+    }
 }
 
-void Calendar::repopulateCache(const ICSParser& parser) {
-    AptCache* aptCache = parser.readAppointments();
-    assert(aptCache);
+void Calendar::scheduleRefresh(int hintSecs)
+{
+    int lifetime = (hintSecs > 0) ? hintSecs : _minRefreshSecs;
+    lifetime = std::max(_minRefreshSecs, std::min(lifetime, _maxRefreshSecs));
+    _refreshTimer.start(lifetime*1000);
 
-    // Replace old cache, update checksum and update name
-    engageBufferLock("replacing old appointment cache");
-    delete _aptCache;
-    _aptCache = aptCache;
-    _calChecksum = parser.checksum();
-    releaseBufferLock("installed new appointment cache");
+    engageBufferLock("publishing next refresh");
+    _nextRefresh = QDateTime::currentDateTime().addSecs(lifetime);
+    releaseBufferLock("published next refresh");
 
-    // Update other attributes that will trigger update signals
-    if (name() != parser.name())
-        setName(parser.name());
-    setStatus(Online);
+    LOG_DEBUG(CLASSNAME, this, LogMessage("Next refresh in %1 seconds").arg(lifetime));
 }
 
-int Calendar::calChecksum() {
-    int retVal;
-    engageBufferLock("accessing calendar checksum");
-    retVal = _calChecksum;
-    releaseBufferLock("accessed calendar checksum");
+bool Calendar::hasNotificationsDueSoon()
+{
+    QDateTime soon = QDateTime::currentDateTime().addSecs(SOONTHRESHOLD);
 
-    return retVal;
+    // Both maps are sorted on time, so only their first entries matter
+    return (!_aptCache->reminders()->isEmpty() && _aptCache->reminders()->begin().key() <= soon)
+            || (!_aptCache->appointments()->isEmpty() && _aptCache->appointments()->begin().key() <= soon);
 }
 
-void Calendar::setCalChecksum(int calChecksum) {
-    engageBufferLock("updating calendar checksum");
-    _calChecksum = calChecksum;
-    releaseBufferLock("updated calendar checksum");
+void Calendar::repopulateCache(const ParseResult& result) {
+    assert(result.cache);
+
+    // Replace old cache, update checksum and update name
+    delete _aptCache;
+    _aptCache = result.cache;
+    engageBufferLock("publishing checksum and timeline");
+    _calChecksum = result.checksum;
+    _timeline = result.timeline;
+    releaseBufferLock("published checksum and timeline");
+    _searchIndex.apply(result.diff);
+    emit timelineChanged(_id);
+
+    // Update other attributes that will trigger update signals
+    if (name() != result.name)
+        setName(result.name);
+    setStatus(Online);
 }
 
 void Calendar::setName(const QString& name) {
-    engageBufferLock("updating name to " + name);
+    engageBufferLock("updating name");
     _name = name;
     releaseBufferLock("updated name");
-    emit nameChanged(this);
+    emit nameChanged(_id);
 }
 
 void Calendar::setStatus(StatusCode status) {
-    engageBufferLock("updating status to " + status);
+    engageBufferLock("updating status");
     _status = status;
     releaseBufferLock("updated status");
-    emit statusChanged(this);
+    emit statusChanged(_id);
 }
 
 QString& operator+(QString& str, Calendar& cal) {
@@ -159,75 +322,131 @@ QString& operator+(QString& str, Calendar& cal) {
     return str;
 }
 
-void Calendar::buildCalendarImage()
-{
-    _image = QImage(IMAGEDIM, IMAGEDIM, QImage::Format_RGB32);
-    _image.fill(_color.rgb());
+void Calendar::parseNetworkResponse(bool success, const QByteArray& data) {
+    Response response;
+    response.success = success;
+    response.data = data;
+    response.freshness = _httpDl.lastFreshnessLifetime();
+
+    // Replays of the BodyCache and local files are never written back
+    if (sender() == &_httpDl && _httpDl.lastResponseCacheable()) {
+        response.cacheable = true;
+        response.etag = _httpDl.lastETag();
+        response.lastModified = _httpDl.lastModified();
+    }
 
-    // Create gradient
-    for (unsigned row = 0; row < (unsigned)IMAGEDIM; ++row) {
-        QRgb* curline = (QRgb*)_image.scanLine(row);
+    // Only one parse runs at a time. A response that arrives in the meantime
+    // replaces any older one that is still waiting.
+    if (_parsing) {
+        LOG_DEBUG(CLASSNAME, this, "Parse in progress, queueing response");
+        _queuedResponse = response;
+        _hasQueuedResponse = true;
+        return;
+    }
 
-        for (unsigned col = 0; col < (unsigned)IMAGEDIM; ++col) {
-            QColor newColor = _color;
-            newColor.setRed(std::min(newColor.red() + ((double)(IMAGEDIM - row)/IMAGEDIM)*75, (double)255));
-            newColor.setGreen(std::min(newColor.green() + ((double)(IMAGEDIM - row)/IMAGEDIM)*75, (double)255));
-            newColor.setBlue(std::min(newColor.blue() + ((double)(IMAGEDIM - row)/IMAGEDIM)*75, (double)255));
+    processResponse(response);
+}
 
-            curline[col] = newColor.rgb();
-        }
+void Calendar::processResponse(const Response& response) {
+    StatusCode oldStatus = status();
+    _nfyTimer.stop();
+
+    if (!response.success) {
+        // In the event of a download error, set the calendar to Offline.
+        LOG_WARNING(CLASSNAME, this, "Error fetching update");
+
+        setStatus(Offline);
+        if (oldStatus != Offline)
+            emit formatNotRecognized(_id);
+
+        // Retry as soon as the limits allow
+        if (!_fileSource)
+            scheduleRefresh(-1);
+        finishRefresh();
+    } else {
+        // Parse on the thread pool; the result comes back as a ParseDone message
+        LOG_DEBUG(CLASSNAME, this, "Parsing ICS data...");
+        _parseResponse = response;
+        _parsing = true;
+        _parseFuture = QtConcurrent::run(&Calendar::parseJob, this, response.data, _calChecksum, _timeline);
     }
 }
 
-void Calendar::fillRectangle(QImage &img, unsigned x, unsigned y, unsigned w, unsigned h, const QColor& color) {
-    for (unsigned row = y; row < y + h; ++row) {
-        QRgb* curline = (QRgb*)img.scanLine(row);
-
-        for (unsigned col = x; col < x + w; ++col)
-            curline[col] = color.rgb();
+void Calendar::parseJob(Calendar* cal, QByteArray data, int oldChecksum, QList<Appointment> oldTimeline) {
+    qint64 started = FlightRecorder::instance()->now();
+    Message msg(Message::ParseDone);
+    ParseResult& result = msg.result;
+    ICSParser parser(data);
+    result.valid = parser.holdsValidICS();
+    result.checksum = parser.checksum();
+    result.name = parser.name();
+    result.refreshInterval = parser.refreshInterval();
+
+    // Only rebuild the AptCache if the calendar changed
+    result.cache = NULL;
+    if (result.valid && result.checksum != oldChecksum) {
+        result.cache = parser.readAppointments(cal->_filters, cal->_id);
+        result.timeline = result.cache->appointments()->values();
+        result.diff = SearchIndex::diff(oldTimeline, result.timeline);
     }
+
+    FlightRecorder::instance()->record(FlightRecorder::ParseFinished, cal,
+                                       result.cache ? result.cache->appointments()->size() : -1,
+                                       int(FlightRecorder::instance()->now() - started));
+    cal->post(msg);
 }
 
-void Calendar::parseNetworkResponse(bool success, QString *data) {
-    assert(data);
-    engageBufferLock("accessing status and timer");
-    StatusCode oldStatus = _status;
-    _nfyTimer.stop();
-    releaseBufferLock("releasing status and timer");
+void Calendar::handleParseDone(const ParseResult& result) {
+    _parsing = false;
 
-    if (!success) {
-        // In the event of a download error, set the calendar to Offline.
-        Logger::instance()->add(CLASSNAME, this, "Error fetching update");
+    // Server headers take precedence over hints inside the calendar file
+    if (!_fileSource)
+        scheduleRefresh(_parseResponse.freshness != -1 ? _parseResponse.freshness : result.refreshInterval);
 
+    // Check ICS validity first
+    if (!result.valid) {
+        LOG_WARNING(CLASSNAME, this, "Downloaded data appears to be invalid ICS");
         setStatus(Offline);
-        if (oldStatus != Offline)
-            emit formatNotRecognized(this);
     } else {
-        Logger::instance()->add(CLASSNAME, this, "Parsing ICS data...");
-        ICSParser parser(*data);
-
-        // Check ICS validity first
-        if (!parser.holdsValidICS()) {
-            Logger::instance()->add(CLASSNAME, this, "Downloaded data appears to be invalid ICS");
-            setStatus(Offline);
-        } else {
-            // Only repopulate the AptCache if the calendar changed
-            if (calChecksum() != parser.checksum())
-                repopulateCache(parser);
-            if (status() == Online) {
-                // This will re-enable the timer and, if the cache was repopulated,
-                // trigger the first batch of notifications.
-                sendNotifications();
-            }
+        // Only a body that parsed may become the copy we fall back on later
+        if (_parseResponse.cacheable)
+            BodyCache::instance()->store(_url, _parseResponse.data, _parseResponse.etag, _parseResponse.lastModified);
+        if (result.cache)
+            repopulateCache(result);
+        if (status() == Online) {
+            // This will re-enable the timer and, if the cache was repopulated,
+            // trigger the first batch of notifications.
+            sendNotifications();
         }
     }
 
-    Logger::instance()->add(CLASSNAME, this, "Finished updating");
+    _parseResponse = Response();
+    finishRefresh();
+}
+
+void Calendar::finishRefresh() {
+    LOG_DEBUG(CLASSNAME, this, "Finished updating");
+    FlightRecorder::instance()->record(FlightRecorder::RefreshFinished, this, status(),
+                                       int((FlightRecorder::instance()->now() - _refreshStartedAt)/1000));
+    emit refreshFinished(_id);
+
+    // Deal with whatever arrived while we were parsing
+    if (_hasQueuedResponse) {
+        Response response = _queuedResponse;
+        _queuedResponse = Response();
+        _hasQueuedResponse = false;
+        processResponse(response);
+    } else if (_updatePending) {
+        bool manual = _pendingManual;
+        _updatePending = false;
+        _pendingManual = false;
+        update(manual);
+    }
 }
 
 void Calendar::parseNetworkResponse_Fail() {
-    Logger::instance()->add(CLASSNAME, this, "Something went wrong while fetching an update");
-    emit formatNotRecognized(this);
+    LOG_WARNING(CLASSNAME, this, "Something went wrong while fetching an update");
+    emit formatNotRecognized(_id);
 }
 
 short Calendar::calcTimeShift() {
@@ -247,23 +466,41 @@ short Calendar::calcTimeShift() {
     }
 }
 
-void Calendar::engageBufferLock(const QString& reason = "no reason given")
+void Calendar::engageBufferLock(const char* reason)
 {
     Q_UNUSED(reason)
 #ifdef VERBOSELOCKING
-    Logger::instance()->add(CLASSNAME, this, "Requesting buffer lock with reason '" + reason + "'");
+    LOG_TRACE(CLASSNAME, this, LogMessage("Requesting buffer lock with reason '%1'").arg(reason));
 #endif
-    _bufferLock.lock();
+    // Only contended acquisitions pay for the extra clock reads
+    LockProfiler* profiler = LockProfiler::instance();
+    LockProfiler::Site* site = profiler->site(reason);
+    qint64 waitNsecs = 0;
+    if (!_bufferLock.tryLock()) {
+        qint64 waitStart = profiler->now();
+        _bufferLock.lock();
+        waitNsecs = std::max(qint64(1), profiler->now() - waitStart);
+        FlightRecorder* recorder = FlightRecorder::instance();
+        recorder->setLabel(profiler->indexOf(site), reason);
+        recorder->record(FlightRecorder::LockWaited, this, int(waitNsecs/1000), profiler->indexOf(site));
+    }
+    _lockSite = site;
+    _lockAcquiredAt = profiler->now();
+    profiler->recordWait(site, waitNsecs);
 #ifdef VERBOSELOCKING
-    Logger::instance()->add(CLASSNAME, this, "Activated buffer lock with reason '" + reason + "'");
+    LOG_TRACE(CLASSNAME, this, LogMessage("Activated buffer lock with reason '%1'").arg(reason));
 #endif
 }
 
-void Calendar::releaseBufferLock(const QString& reason = "no reason given")
+void Calendar::releaseBufferLock(const char* reason)
 {
     Q_UNUSED(reason)
+    LockProfiler* profiler = LockProfiler::instance();
+    LockProfiler::Site* site = _lockSite;
+    qint64 holdNsecs = profiler->now() - _lockAcquiredAt;
     _bufferLock.unlock();
+    profiler->recordHold(site, holdNsecs);
 #ifdef VERBOSELOCKING
-    Logger::instance()->add(CLASSNAME, this, "Released buffer lock with reason '" + reason + "'");
+    LOG_TRACE(CLASSNAME, this, LogMessage("Released buffer lock with reason '%1'").arg(reason));
 #endif
 }
@@ -2,14 +2,18 @@
 #define CALENDAR_H
 
 #include "logger.h"
+#include "mailbox.h"
+#include "lockprofiler.h"
 #include "icsparser.h"
+#include "appointment.h"
+#include "searchindex.h"
 #include "httpdownloader.h"
 #include <QUrl>
-#include <QColor>
+#include <QEvent>
 #include <QTimer>
-#include <QImage>
 #include <QMutex>
 #include <QDebug>
+#include <QFuture>
 #include <QString>
 #include <QObject>
 #include <QMetaType>
@@ -19,12 +23,21 @@
 #include <QNetworkAccessManager>
 
 class AptCache;
-class Appointment;
+class FilterRules;
+class LocalFileSource;
 class QNetworkReply;
 class QNetworkAccessManager;
 
 /**
-  * Represents an online iCal calendar.
+  * Represents an online iCal calendar. Calendars with a file:// URL are read
+  * from the local file system and refreshed whenever the file changes.
+  *
+  * Each calendar is an actor: it lives on one of CalendarDB's shard threads and
+  * owns its appointment cache, timers and downloader exclusively. Refresh
+  * requests, parse results and notification ticks arrive as messages in a
+  * lock-free mailbox and are handled one by one on the calendar's own thread, so
+  * none of that state needs a lock. Only the name, status and next refresh time
+  * are published to other threads, under _bufferLock.
   * \author Pieter De Decker
   */
 class Calendar : public QObject
@@ -32,7 +45,10 @@ class Calendar : public QObject
     Q_OBJECT
     Q_ENUMS(ExceptionCode)
 public:
-    Calendar(const QString& url, const QColor& color);
+    /** 'id' identifies the calendar in CalendarDB and in every signal it sends.
+      * 'color' is the color tag as "#rrggbb". 'filters', if given, decide which
+      * appointments are muted or escalated and must outlive the calendar. */
+    Calendar(int id, const QString& url, const QString& color, const FilterRules* filters = NULL);
     ~Calendar();
 
     /** STATUS CODES FOR CALENDARS
@@ -47,6 +63,7 @@ public:
     enum StatusCode { NotLoaded, Online, Offline };
 
     /* Getters */
+    int id() const { return _id; }
     QUrl url() const { return _url; }
     QString name() {     // This getter requires thread sync
         engageBufferLock("getting name attribute");
@@ -54,8 +71,7 @@ public:
         releaseBufferLock("got name attribute");
         return retVal;
     }
-    const QColor& color() const { return _color; }
-    const QImage& image() const { return _image; }
+    const QString& color() const { return _color; }
     static short getTimeShift() { return Calendar::timeShift; }
     StatusCode status() {       // This getter requires thread sync
         engageBufferLock("getting status attribute");
@@ -64,15 +80,45 @@ public:
         return retVal;
     }
 
-    /** [THREAD-SAFE] Triggers a refresh of the calendar. */
-    void update();
+    /** [THREAD-SAFE] Getter for the moment of the next automatic refresh. */
+    QDateTime nextRefresh() {
+        engageBufferLock("getting next refresh time");
+        QDateTime retVal = _nextRefresh;
+        releaseBufferLock("got next refresh time");
+        return retVal;
+    }
 
-    /** This function is used by view classes to draw a border around
-      * a calendar image. Since this image is resized often, we have
-      * to add the border right before showing the image on screen.
-      */
-    static void drawBorder(QImage& img, int thickness, const QColor& color);
+    /** [THREAD-SAFE] Checksum of the calendar file behind the current appointments,
+      * or 0 if nothing was loaded yet. */
+    int checksum() {
+        engageBufferLock("getting checksum");
+        int retVal = _calChecksum;
+        releaseBufferLock("got checksum");
+        return retVal;
+    }
 
+    /** [THREAD-SAFE] All appointments of the calendar as of the last parse, sorted on
+      * start time. The list is shared, so getting it is cheap. */
+    QList<Appointment> timeline() {
+        engageBufferLock("getting timeline");
+        QList<Appointment> retVal = _timeline;
+        releaseBufferLock("got timeline");
+        return retVal;
+    }
+
+    /** [THREAD-SAFE] Appointments whose summary matches 'query', sorted on start time.
+      * See SearchIndex::search for the query syntax. */
+    QList<Appointment> search(const QString& query, int limit) { return _searchIndex.search(query, limit); }
+
+    /** [THREAD-SAFE] Bounds the freshness lifetime this calendar derives from
+      * server hints. Calendars without hints are refreshed every 'minSecs'. */
+    void setRefreshLimits(int minSecs, int maxSecs);
+public slots:
+    /** [THREAD-SAFE] Triggers a refresh of the calendar. Manual refreshes are fetched
+      * before automatic ones, and calendars with reminders coming up soon go first
+      * among the automatic ones. */
+    void update(bool manual = false);
+public:
     /** [THREAD-SAFE] String representation generator. Do not use this internally where
       * _bufferLock has been engaged, this will block the program! QString concatenation
       * will not engage _bufferLock and can be used internally. */
@@ -85,31 +131,123 @@ public:
 
         return retVal;
     }
+protected:
+    /** Drains the mailbox when a MAILBOXEVENT arrives. */
+    bool event(QEvent* e);
 private slots:
-    /** [THREAD-SAFE] Analyses the downloaded calendar file and rebuilds the cache if the
-      * checksum of the file has changed. The function DOESN'T get ownership over 'data'. */
-    void parseNetworkResponse(bool success, QString* data);
+    /** Analyses the downloaded calendar file and rebuilds the cache if the
+      * checksum of the file has changed. Parsing happens on the global thread pool;
+      * the result comes back as a ParseDone message. */
+    void parseNetworkResponse(bool success, const QByteArray& data);
 
-    /** [THREAD-SAFE] Called instead of parseNetworkResponse when something goes wrong. */
+    /** Called instead of parseNetworkResponse when something goes wrong. */
     void parseNetworkResponse_Fail();
 
-    /** [THREAD-SAFE] On regular intervals, this function is
-      * called to trigger notifications about ongoing appointments
-      * and reminders. */
+    /** Posts a NotificationTick message when the notification timer fires. */
+    void postNotificationTick();
+
+    /** Posts a Refresh message when the refresh timer fires. */
+    void refreshTimerFired();
+private:
+    static LogCategory CLASSNAME;
+
+    /** Everything a background parse produces. 'cache' is NULL if the checksum
+      * didn't change; otherwise ownership passes to whoever receives the result. */
+    struct ParseResult {
+        ParseResult() : valid(false), checksum(0), refreshInterval(-1), cache(NULL) {}
+
+        bool valid;
+        int checksum;
+        QString name;
+        int refreshInterval;
+        AptCache* cache;
+        QList<Appointment> timeline;
+
+        /** Changes against the previous timeline, for the search index. */
+        SearchIndex::Diff diff;
+    };
+
+    /** MESSAGES HANDLED BY THE CALENDAR ACTOR
+      *
+      * Refresh
+      *     Start a download ('manual' selects the fetch priority).
+      * ParseDone
+      *     A background parse finished; 'result' holds its outcome.
+      * NotificationTick
+      *     Check for ongoing appointments and reminders.
+      * SetRefreshLimits
+      *     Change the freshness lifetime bounds to 'minSecs' and 'maxSecs'.
+      */
+    struct Message {
+        enum Type { Refresh, ParseDone, NotificationTick, SetRefreshLimits };
+
+        Message(Type t = Refresh) : type(t), manual(false), minSecs(0), maxSecs(0) {}
+
+        Type type;
+        bool manual;
+        ParseResult result;
+        int minSecs;
+        int maxSecs;
+    };
+
+    /** [THREAD-SAFE] Drops a message in the mailbox and wakes up the calendar's
+      * thread if the mailbox was empty. */
+    void post(const Message& msg);
+
+    /** Handles all messages in the mailbox. */
+    void drain();
+
+    /** Dispatches a single message to its handler. */
+    void handleMessage(Message& msg);
+
+    /** Handles a Refresh message: starts a download or reads the local file. */
+    void handleRefresh(bool manual);
+
+    /** Handles a ParseDone message: installs the new cache and sends notifications. */
+    void handleParseDone(const ParseResult& result);
+
+    /** [WORKER THREAD] Parses ICS data and builds a new AptCache if the checksum
+      * differs from 'oldChecksum', along with its diff against 'oldTimeline'.
+      * Posts the result to 'cal' as a ParseDone message. */
+    static void parseJob(Calendar* cal, QByteArray data, int oldChecksum, QList<Appointment> oldTimeline);
+
+    /** A download result along with what we need to know about it once it parsed. */
+    struct Response {
+        Response() : success(false), freshness(-1), cacheable(false) {}
+
+        bool success;
+        QByteArray data;
+        /** Freshness lifetime announced by the server, -1 if none. */
+        int freshness;
+        /** Whether 'data' came fresh off the network and may go into the BodyCache. */
+        bool cacheable;
+        QByteArray etag;
+        QByteArray lastModified;
+    };
+
+    /** Handles a download result: failures are processed right away, successful
+      * downloads are handed to the thread pool. */
+    void processResponse(const Response& response);
+
+    /** Broadcasts refreshFinished and continues with queued work, if any. */
+    void finishRefresh();
+
+    /** On regular intervals, this function is called to trigger notifications
+      * about ongoing appointments and reminders. */
     void sendNotifications();
     void sendNotifications_Ongoing();
     void sendNotifications_Reminders();
-private:
-    static const char* CLASSNAME;
 
-    /** [THREAD-SAFE] Repopulates the appointment cache with data from an ICSParser. */
-    void repopulateCache(const ICSParser& parser);
+    /** Schedules the next automatic refresh. 'hintSecs' is the freshness lifetime
+      * suggested by the server or the calendar file, or -1 if there is none.
+      * The result is clamped to the limits set by setRefreshLimits. */
+    void scheduleRefresh(int hintSecs);
 
-    /** [THREAD-SAFE] Getter for the calendar checksum. */
-    int calChecksum();
+    /** Returns true if a reminder or appointment is due within SOONTHRESHOLD seconds. */
+    bool hasNotificationsDueSoon();
 
-    /** [THREAD-SAFE] Setter for the calendar checksum. */
-    void setCalChecksum(int calChecksum);
+    /** Installs the appointment cache built by a background parse. */
+    void repopulateCache(const ParseResult& result);
 
     /** [THREAD-SAFE] Setter for the calendar name. Notifies observers afterwards. */
     void setName(const QString& name);
@@ -121,61 +259,108 @@ private:
       * synchronization only. */
     friend QString& operator+(QString& str, Calendar& cal);
 
-    /** Creates the pixmap for this calendar based on the color. */
-    void buildCalendarImage();
-
-    /** Fills a rectangle area in an image with a color. */
-    static void fillRectangle(QImage& img, unsigned x, unsigned y, unsigned w, unsigned h, const QColor& color);
-
     /** Calculates the user's time zone shift compared to UTC.
       * \todo This will likely cause a bug when used in Newfoundland or other places
       * that have non-integer timezone shifts. */
     static short calcTimeShift();
 
-    /** [THREAD-SAFE] Helper: engages _bufferLock and writes status info about this to the log. */
-    void engageBufferLock(const QString& reason);
+    /** [THREAD-SAFE] Helper: engages _bufferLock and records the wait time for 'reason'
+      * in the LockProfiler. 'reason' must be a string literal: it identifies the lock site. */
+    void engageBufferLock(const char* reason);
 
-    /** [THREAD-SAFE] Helper: releases _bufferLock and writes status info about this to the log. */
-    void releaseBufferLock(const QString& reason);
+    /** [THREAD-SAFE] Helper: releases _bufferLock and records how long it was held
+      * under the reason it was engaged with. */
+    void releaseBufferLock(const char* reason);
 
-    QUrl _url;        /* Should not change after the constructor finishes! */
+    /* Immutable after the constructor finishes, so readable from any thread */
+    int _id;
+    QUrl _url;
+    QString _color;
+    const FilterRules* _filters;
+
+    /* Published state. _bufferLock required for access. */
     QString _name;
-    QColor _color;
-    QImage _image;
+    enum StatusCode _status;
+    QDateTime _nextRefresh;
+    QList<Appointment> _timeline;
+
+    /** Word index over _timeline. Has its own lock, so searches don't hold up
+      * the other getters. */
+    SearchIndex _searchIndex;
+
+    /** Mutex for the published state. */
+    QMutex _bufferLock;
+
+    /** Lock site and acquisition time of the current _bufferLock holder, for the LockProfiler. */
+    LockProfiler::Site* _lockSite;
+    qint64 _lockAcquiredAt;
+
+    /* Actor state. Only touched on the calendar's own thread. */
+    Mailbox<Message> _mailbox;
     QTimer _nfyTimer;
+    QTimer _refreshTimer;
     HttpDownloader _httpDl;
 
-    /** Holds a hash that helps detect changes in new calendars. _bufferLock required for access. */
-    int _calChecksum;
+    /** Replaces _httpDl for file:// calendars, NULL otherwise. */
+    LocalFileSource* _fileSource;
 
-    /** Represents the current state of the calendar. _bufferLock required for access. */
-    enum StatusCode _status;
+    /** The background parse, if any. Only one parse runs at a time. */
+    QFuture<void> _parseFuture;
+    bool _parsing;
+    /** The response being parsed. Stored in the BodyCache if it turns out valid. */
+    Response _parseResponse;
 
-    /** Contains all ongoing appointments, future appointments, scheduled reminders and
-      * the network access manager. _bufferLock required for access. */
-    AptCache* _aptCache;
+    /** Latest response that arrived while a parse was running. */
+    Response _queuedResponse;
+    bool _hasQueuedResponse;
 
-    /** Mutex for _aptCache, _status and _calChecksum. */
-    QMutex _bufferLock;
+    /** When the current refresh started, on the FlightRecorder's clock. */
+    qint64 _refreshStartedAt;
+
+    /** Set when a refresh is requested while a parse is running, and whether any
+      * of those requests was manual, so the replay keeps its priority. */
+    bool _updatePending;
+    bool _pendingManual;
+
+    /** Freshness lifetime bounds in seconds. */
+    int _minRefreshSecs;
+    int _maxRefreshSecs;
+
+    /** Holds a hash that helps detect changes in new calendars. Only written on the
+      * calendar's own thread, under _bufferLock since checksum() reads it elsewhere. */
+    int _calChecksum;
+
+    /** Contains all ongoing appointments, future appointments and scheduled reminders. */
+    AptCache* _aptCache;
 
     static short timeShift;
-    static const short IMAGEDIM;
+    static const int SOONTHRESHOLD;
+    static const QEvent::Type MAILBOXEVENT;
 signals:
+    /* All signals carry the calendar's ID rather than a pointer: they are queued
+     * across threads and may arrive after the calendar has been removed. */
+
     /** Broadcast when the downloaded calendar has an unrecognized format. */
-    void formatNotRecognized(Calendar*);
+    void formatNotRecognized(int id);
 
     /** Broadcast when the calendar's status code changes. Useful for
       * providing availability updates to the view. */
-    void statusChanged(Calendar*);
+    void statusChanged(int id);
 
     /** Broadcast when the calendar name changes. */
-    void nameChanged(Calendar*);
+    void nameChanged(int id);
 
     /** Broadcasts new ongoing appointments at semi-regular intervals. */
-    void newOngoingAppointments(Calendar*, const QList<Appointment>&);
+    void newOngoingAppointments(int id, const QList<Appointment>&);
 
     /** Broadcasts reminders at semi-regular intervals. */
-    void newReminders(Calendar*, const QList<Appointment>&);
+    void newReminders(int id, const QList<Appointment>&);
+
+    /** Broadcast whenever a download has been processed, successful or not. */
+    void refreshFinished(int id);
+
+    /** Broadcast when the calendar's appointments changed. */
+    void timelineChanged(int id);
 };
 
 Q_DECLARE_METATYPE(Calendar*)
@@ -2,133 +2,235 @@
 
 #include "logger.h"
 #include "calendar.h"
-#include <QFile>
-#include <QTextStream>
-
-const char* CalendarDB::CLASSNAME = "CalendarDB";
+#include "bodycache.h"
+#include "appointment.h"
+#include "calendarshard.h"
+#include "fetchscheduler.h"
+#include <cassert>
+#include <cstdlib>
+#include <QMetaType>
+#include <algorithm>
+
+LogCategory CalendarDB::CLASSNAME("CalendarDB");
+const int CalendarDB::DEFAULTMINREFRESH = 60;
+const int CalendarDB::DEFAULTMAXREFRESH = 6*60*60;
 
 CalendarDB::CalendarDB()
 {
-    _refreshInterval = 1;
+    _minRefreshInterval = DEFAULTMINREFRESH;
+    _maxRefreshInterval = DEFAULTMAXREFRESH;
+
+    // Calendar signals cross thread boundaries
+    qRegisterMetaType<Calendar*>("Calendar*");
+    qRegisterMetaType<QList<Appointment> >("QList<Appointment>");
+
+    connect(&_dispatcher, SIGNAL(notificationsDue(QList<Notification>)), this, SIGNAL(notificationsDue(QList<Notification>)));
 
-    // Timer setup
-    connect(&_autoUpdate, SIGNAL(timeout()), this, SLOT(updateCalendars()));
-    _autoUpdate.setInterval(_refreshInterval*1000*60);
-    _autoUpdate.start();
+    int shardCount = std::max(1, QThread::idealThreadCount());
+    for (int i = 0; i < shardCount; ++i)
+        _shards.push_back(new CalendarShard());
+    LOG_INFO(CLASSNAME, NULL, LogMessage("Started %1 calendar shards").arg(shardCount));
 }
 
 CalendarDB::~CalendarDB()
 {
-    _calLock.lock();
-    for (QLinkedList<Calendar*>::iterator it = _calendars.begin();
-         it != _calendars.end(); ++it) {
-        delete *it;
-    }
-    _calLock.unlock();
+    foreach (Calendar* cal, _calendars.calendars())
+        static_cast<CalendarShard*>(cal->thread())->destroy(cal);
+    qDeleteAll(_shards);
 }
 
 void CalendarDB::loadCalendars()
 {
-    QFile file("calendars");
-    Logger::instance()->add(CLASSNAME, "Opening calendar file...");
+    LOG_DEBUG(CLASSNAME, NULL, "Loading calendar configuration...");
+    _store.load();
+    _filters.load();
+
+    // Global limits apply to every calendar created below that has none of its own
+    int minSecs = _store.setting("minrefresh", _minRefreshInterval);
+    int maxSecs = _store.setting("maxrefresh", _maxRefreshInterval);
+    if (0 < minSecs && minSecs <= maxSecs) {
+        _minRefreshInterval = minSecs;
+        _maxRefreshInterval = maxSecs;
+    } else {
+        LOG_WARNING(CLASSNAME, NULL, LogMessage("Ignoring invalid refresh limits %1-%2").arg(minSecs).arg(maxSecs));
+    }
 
-    if (!file.open(QIODevice::ReadOnly))
-        return;
+    int threshold = _store.setting("summarythreshold", _dispatcher.summaryThreshold());
+    if (threshold > 0)
+        _dispatcher.setSummaryThreshold(threshold);
+    else
+        LOG_WARNING(CLASSNAME, NULL, LogMessage("Ignoring invalid summary threshold %1").arg(threshold));
+
+    foreach (CalendarConfig config, _store.calendars()) {
+        LOG_DEBUG(CLASSNAME, NULL, LogMessage("Detected calendar %1.").arg(config.url));
 
-    // Read one URL per line
-    while (!file.atEnd()) {
-        // Vary calendar colors by varying hue values
-        QColor calColor = composeNextColor();
+        // Lists imported from older versions don't have colors yet
+        if (config.color.isEmpty()) {
+            config.color = composeNextColor();
+            _store.update(config);
+        }
 
-        QString line = file.readLine();
-        line = line.trimmed();
-        Logger::instance()->add(CLASSNAME, "Detected calendar " + line + ".");
-        addCalendar(line, calColor, false);
+        // ...and may list a calendar twice
+        if (!createCalendar(config)) {
+            LOG_WARNING(CLASSNAME, NULL, LogMessage("Dropping duplicate calendar %1").arg(config.url));
+            _store.remove(config.id);
+        }
     }
 }
 
-void CalendarDB::addCalendar(const QString &url, const QColor &color, bool writeChange)
+int CalendarDB::addCalendar(const QString &url, const QString &color, bool writeChange)
 {
-    // Create new calendar, trigger its first update
-    Calendar* newCalendar = new Calendar(url, color);
-    _calLock.lock();
-    _calendars.push_back(newCalendar);
-    emit newCalendarAdded(newCalendar);
-    Logger::instance()->add(CLASSNAME, "Added calendar " + newCalendar->toString());
-    newCalendar->update();
-    _calLock.unlock();
+    CalendarConfig config;
+    config.url = url;
+    config.color = color;
+    if (_calendars.findByUrl(QUrl::fromEncoded(url.toUtf8()))) {
+        LOG_INFO(CLASSNAME, NULL, LogMessage("Calendar %1 was already added").arg(url));
+        return -1;
+    }
 
-    // Write the updated list to the savefile if needed
     if (writeChange)
-        writeCalendars();
+        _store.add(config);
+    else
+        config.id = _store.reserveId();
+
+    createCalendar(config);
+    return config.id;
 }
 
-void CalendarDB::removeCalendar(Calendar *cal)
+bool CalendarDB::createCalendar(const CalendarConfig& config)
 {
+    // Create new calendar, trigger its first update
+    Calendar* newCalendar = new Calendar(config.id, config.url, config.color, &_filters);
+    if (!_calendars.add(newCalendar)) {
+        delete newCalendar;
+        return false;
+    }
 
-    // Search for the pointer in the linked list
-    _calLock.lock();
-    for (QLinkedList<Calendar*>::iterator it = _calendars.begin();
-         it != _calendars.end(); ++it) {
-        if (*it == cal) {
-            // Erase the calendar from the list
-            _calendars.erase(it);
-            emit removingCalendar(cal);
-            delete cal;
-            _calLock.unlock();
-
-            // Write changes
-            writeCalendars();
-            return;
-        }
+    if (config.minRefresh > 0 && config.minRefresh <= config.maxRefresh)
+        newCalendar->setRefreshLimits(config.minRefresh, config.maxRefresh);
+    else
+        newCalendar->setRefreshLimits(_minRefreshInterval, _maxRefreshInterval);
+    connect(newCalendar, SIGNAL(refreshFinished(int)), this, SLOT(saveRefreshState(int)));
+
+    // Notifications skip the event queue: the dispatcher batches them itself
+    connect(newCalendar, SIGNAL(newOngoingAppointments(int,QList<Appointment>)),
+            &_dispatcher, SLOT(queueOngoing(int,QList<Appointment>)), Qt::DirectConnection);
+    connect(newCalendar, SIGNAL(newReminders(int,QList<Appointment>)),
+            &_dispatcher, SLOT(queueReminders(int,QList<Appointment>)), Qt::DirectConnection);
+    emit newCalendarAdded(config.id);
+    LOG_INFO(CLASSNAME, NULL, LogMessage("Added calendar %1 with ID %2").arg(newCalendar->url()).arg(config.id));
+
+    // From here on, the calendar only talks to us through its mailbox and signals
+    leastLoadedShard()->adopt(newCalendar);
+    newCalendar->update();
+    return true;
+}
+
+bool CalendarDB::removeCalendar(int id)
+{
+    Calendar* cal = _calendars.find(id);
+    if (!cal) {
+        LOG_WARNING(CLASSNAME, NULL, LogMessage("Can't remove unknown calendar %1").arg(id));
+        return false;
     }
-    _calLock.unlock();
 
-    // If this point is reached, the calendar couldn't be found. This
-    // behavior is likely caused by a bug, so it's a good idea to
-    // raise SIGABRT here.
-    abort();
+    // Observers may still look the calendar up while handling the signal
+    emit removingCalendar(id);
+    _calendars.take(id);
+    static_cast<CalendarShard*>(cal->thread())->destroy(cal);
+
+    // Write changes
+    _store.remove(id);
+    return true;
 }
 
-QColor CalendarDB::composeNextColor()
+QString CalendarDB::composeNextColor()
 {
     // Produce a hue value based on the next calendar ID
-    QColor calColor(0, 0, 0);
-    calColor.setHsv((_calendars.size() * 50) % 360, 255, 255);
+    int hue = (_calendars.size() * 50) % 360;
+
+    // Convert to RGB at full saturation and value. The model doesn't link QtGui,
+    // so QColor::setHsv isn't available here.
+    int rising = 255 * (60 - std::abs(hue % 120 - 60)) / 60;
+    int rgb[3];
+    switch (hue / 60) {
+    case 0:  rgb[0] = 255;    rgb[1] = rising; rgb[2] = 0;      break;
+    case 1:  rgb[0] = rising; rgb[1] = 255;    rgb[2] = 0;      break;
+    case 2:  rgb[0] = 0;      rgb[1] = 255;    rgb[2] = rising; break;
+    case 3:  rgb[0] = 0;      rgb[1] = rising; rgb[2] = 255;    break;
+    case 4:  rgb[0] = rising; rgb[1] = 0;      rgb[2] = 255;    break;
+    default: rgb[0] = 255;    rgb[1] = 0;      rgb[2] = rising; break;
+    }
 
+    QString calColor("#");
+    for (int i = 0; i < 3; ++i)
+        calColor += QString::number(rgb[i], 16).rightJustified(2, '0');
     return calColor;
 }
 
-void CalendarDB::writeCalendars()
+CalendarShard* CalendarDB::leastLoadedShard()
+{
+    assert(!_shards.isEmpty());
+    CalendarShard* best = _shards.first();
+    foreach (CalendarShard* shard, _shards) {
+        if (shard->load() < best->load())
+            best = shard;
+    }
+
+    return best;
+}
+
+void CalendarDB::setRefreshLimits(int minSecs, int maxSecs, bool writeChange)
 {
-    QFile file("calendars");
-    Logger::instance()->add(CLASSNAME, "Writing calendar list to disk...");
+    assert(0 < minSecs && minSecs <= maxSecs);
+    _minRefreshInterval = minSecs;
+    _maxRefreshInterval = maxSecs;
+    if (writeChange) {
+        _store.setSetting("minrefresh", minSecs);
+        _store.setSetting("maxrefresh", maxSecs);
+    }
 
-    // Open file output
-    if (!file.open(QIODevice::WriteOnly))
+    // Calendars with limits of their own keep them
+    foreach (Calendar* cal, _calendars.calendars()) {
+        CalendarConfig config;
+        if (!_store.find(cal->id(), config) || config.minRefresh <= 0)
+            cal->setRefreshLimits(minSecs, maxSecs);
+    }
+}
+
+void CalendarDB::setSummaryThreshold(int threshold, bool writeChange)
+{
+    _dispatcher.setSummaryThreshold(threshold);
+    if (writeChange)
+        _store.setSetting("summarythreshold", threshold);
+}
+
+void CalendarDB::saveRefreshState(int id)
+{
+    // Refreshes of removed and unsaved calendars don't matter
+    CalendarConfig config;
+    Calendar* cal = _calendars.find(id);
+    if (!cal || !_store.find(id, config))
         return;
-    QTextStream out(&file);
 
-    // Write the URLs
-    _calLock.lock();
-    foreach (Calendar* cal, _calendars)
-        out << cal->url().toString() << "\n";
-    _calLock.unlock();
+    QByteArray etag, lastModified;
+    BodyCache::instance()->validators(cal->url(), etag, lastModified);
+    int checksum = cal->checksum();
+    if (checksum == config.checksum && etag == config.etag && lastModified == config.lastModified)
+        return;
 
-    // Done.
-    file.close();
+    config.checksum = checksum;
+    config.etag = etag;
+    config.lastModified = lastModified;
+    _store.update(config);
 }
 
 void CalendarDB::updateCalendars()
 {
-    _calLock.lock();
-    Logger::instance()->add(CLASSNAME, "Updating all calendars...");
-    _autoUpdate.stop();
-
-    // Run the update command on all calendars
-    foreach (Calendar* item, _calendars)
-        item->update();
+    LOG_DEBUG(CLASSNAME, NULL, "Updating all calendars...");
 
-    _autoUpdate.start(_autoUpdate.interval());
-    _calLock.unlock();
+    // Post a refresh message to all calendars
+    foreach (Calendar* item, _calendars.calendars())
+        item->update(true);
+    LOG_DEBUG(CLASSNAME, NULL, "Fetch queue: " + FetchScheduler::instance()->statsString());
 }
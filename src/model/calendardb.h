@@ -4,12 +4,20 @@
 #include <QObject>
 
 #include "calendar.h"
-#include <QColor>
+#include "configstore.h"
+#include "filterrules.h"
+#include "calendarregistry.h"
+#include "notificationdispatcher.h"
+#include <QList>
 #include <QString>
-#include <QLinkedList>
+
+class CalendarShard;
 
 /**
-  * Manages a list of calendars.
+  * Manages a list of calendars. Calendars run as actors on a small pool of shard
+  * threads; CalendarDB itself is only used from the thread that created it.
+  * Calendars are identified by the stable ID of their configuration entry, and
+  * no two calendars share a URL.
   * \author Pieter De Decker
   */
 class CalendarDB : public QObject
@@ -22,47 +30,89 @@ public:
     /** Attempts to load previously saved calendars. */
     void loadCalendars();
 
-    /** Adds calendar at a certain URL with a chosen color tag. Saves settings to file by default. */
-    void addCalendar(const QString &url, const QColor& color, bool writeChange = true);
+    /** Adds calendar at a certain URL with a chosen color tag ("#rrggbb"). Saves it in the
+      * configuration store by default. Returns the ID of the new calendar, or -1 if
+      * a calendar with the same URL already exists. */
+    int addCalendar(const QString &url, const QString& color, bool writeChange = true);
+
+    /** Removes a calendar from the list and from the configuration store. Returns
+      * false if there is no calendar with this ID. */
+    bool removeCalendar(int id);
+
+    /** Returns the calendar with this ID, or NULL if it doesn't exist (anymore). */
+    Calendar* calendar(int id) const { return _calendars.find(id); }
+
+    /** All calendars. */
+    const CalendarRegistry& calendars() const { return _calendars; }
+
+    /** Composes the color for the next calendar by varying the hue. Returns "#rrggbb". */
+    QString composeNextColor();
 
-    /** Removes a certain calendar from the list and saves settings to file. Has
-      * O(n) time complexity under the current list-based implementation. */
-    void removeCalendar(Calendar* cal);
+    /** Batches with at least this many notifications of one kind are shown as a summary.
+      * The threshold is saved unless 'writeChange' is false and applied again by
+      * loadCalendars(). */
+    int summaryThreshold() const { return _dispatcher.summaryThreshold(); }
+    void setSummaryThreshold(int threshold, bool writeChange = true);
 
-    /** Composes the color for the next calendar by varying the hue. */
-    QColor composeNextColor();
+    /** Sets the bounds (in seconds) for the freshness lifetime of every calendar
+      * without limits of its own, and saves them unless 'writeChange' is false.
+      * Calendars that don't receive freshness hints are refreshed at the lower bound.
+      * The saved bounds are applied by loadCalendars(). */
+    void setRefreshLimits(int minSecs, int maxSecs, bool writeChange = true);
+
+    static const int DEFAULTMINREFRESH;
+    static const int DEFAULTMAXREFRESH;
 private:
-    static const char* CLASSNAME;
+    static LogCategory CLASSNAME;
+
+    /** Creates, registers and starts the calendar described by 'config'. Returns
+      * false if its URL is already taken. */
+    bool createCalendar(const CalendarConfig& config);
+
+    /** Returns the shard with the fewest calendars. */
+    CalendarShard* leastLoadedShard();
 
-    /** Writes the current list of calendars to disk. */
-    void writeCalendars();
+    /** All calendars, by ID and URL. */
+    CalendarRegistry _calendars;
 
-    /** Sets up a single-shot timer for the next calendar refresh. */
-    void scheduleUpdate();
+    /** Worker threads running the calendars, one per core. */
+    QList<CalendarShard*> _shards;
 
-    /** The list of all calendars. */
-    QLinkedList<Calendar*> _calendars;
-    QMutex _calLock;
+    /** Persistent calendar settings. */
+    ConfigStore _store;
 
-    /* Update triggers */
-    QTimer _autoUpdate;
-    QMutex _autoUpdateLock;
+    /** Batches the notifications of all calendars. */
+    NotificationDispatcher _dispatcher;
 
-    /** Number of minutes to wait before refreshing all calendars */
-    int _refreshInterval;
+    /** Mute and escalation rules, shared by all calendars. Loaded before the
+      * calendars and never changed afterwards. */
+    FilterRules _filters;
+
+    /** Freshness lifetime bounds in seconds, applied to every calendar. */
+    int _minRefreshInterval;
+    int _maxRefreshInterval;
 public slots:
-    /** Updates all calendars. If a calendar file hasn't changed (as determined
-      * by the checksum), its buffers will not be re-populated. */
+    /** Updates all calendars right away. Calendars refresh themselves automatically
+      * based on server hints, so this is only needed for manual refreshes. If a
+      * calendar file hasn't changed (as determined by the checksum), its buffers
+      * will not be re-populated. */
     void updateCalendars();
+private slots:
+    /** Saves the checksum and validators of a calendar after a refresh, if they changed. */
+    void saveRefreshState(int id);
 signals:
     /** Informs observers of a successfully added calendar */
-    void newCalendarAdded(Calendar*);
+    void newCalendarAdded(int id);
 
     /** Warns observers that a calendar will be deleted */
-    void removingCalendar(Calendar*);
+    void removingCalendar(int id);
 
     /** Broadcast when an invalid format is detected on a calendar. */
-    void invalidFormatDetected(Calendar*);
+    void invalidFormatDetected(int id);
+
+    /** Broadcasts the ongoing appointments and reminders of all calendars, once per
+      * notification tick. */
+    void notificationsDue(const QList<Notification>& batch);
 };
 
 #endif // CALENDARDB_H
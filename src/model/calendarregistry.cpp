@@ -0,0 +1,59 @@
+#include "calendarregistry.h"
+
+#include "calendar.h"
+#include <cassert>
+
+bool CalendarRegistry::add(Calendar* cal) {
+    assert(cal);
+    QString url = normalizeUrl(cal->url());
+    if (_indices.contains(cal->id()) || _urls.contains(url))
+        return false;
+
+    _indices.insert(cal->id(), _calendars.size());
+    _urls.insert(url, cal->id());
+    _calendars.append(cal);
+    return true;
+}
+
+Calendar* CalendarRegistry::take(int id) {
+    QHash<int, int>::iterator it = _indices.find(id);
+    if (it == _indices.end())
+        return NULL;
+
+    // Fill the hole with the last calendar so the array stays dense
+    int index = *it;
+    Calendar* cal = _calendars[index];
+    Calendar* last = _calendars.last();
+    _calendars[index] = last;
+    _indices[last->id()] = index;
+    _calendars.pop_back();
+
+    _indices.remove(id);
+    _urls.remove(normalizeUrl(cal->url()));
+    return cal;
+}
+
+Calendar* CalendarRegistry::find(int id) const {
+    QHash<int, int>::const_iterator it = _indices.find(id);
+    if (it == _indices.end())
+        return NULL;
+    return _calendars[*it];
+}
+
+Calendar* CalendarRegistry::findByUrl(const QUrl& url) const {
+    QHash<QString, int>::const_iterator it = _urls.find(normalizeUrl(url));
+    if (it == _urls.end())
+        return NULL;
+    return find(*it);
+}
+
+QString CalendarRegistry::normalizeUrl(const QUrl& url) {
+    QUrl normalized(url);
+    QString scheme = url.scheme().toLower();
+    normalized.setScheme(scheme);
+    normalized.setHost(url.host().toLower());
+    if ((scheme == "http" && url.port() == 80) || (scheme == "https" && url.port() == 443))
+        normalized.setPort(-1);
+
+    return normalized.toString(QUrl::RemoveFragment | QUrl::StripTrailingSlash);
+}
@@ -0,0 +1,55 @@
+#ifndef CALENDARREGISTRY_H
+#define CALENDARREGISTRY_H
+
+#include <QUrl>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+class Calendar;
+
+/**
+  * Index of all calendars by ID and by normalized URL. Calendars are kept in a
+  * dense array so iterating over them touches contiguous memory; removal swaps the
+  * last calendar into the freed slot. Adding, removing and both lookups take
+  * constant time. The order of calendars changes when one is removed.
+  * Not thread-safe: only used from CalendarDB's thread.
+  * \author Pieter De Decker
+  */
+class CalendarRegistry
+{
+public:
+    /** Registers a calendar. Returns false, without registering it, if its ID or
+      * normalized URL is already taken. */
+    bool add(Calendar* cal);
+
+    /** Unregisters the calendar with this ID and returns it, or NULL if there is none. */
+    Calendar* take(int id);
+
+    /** Returns the calendar with this ID, or NULL if there is none. */
+    Calendar* find(int id) const;
+
+    /** Returns the calendar whose URL normalizes to the same string, or NULL. */
+    Calendar* findByUrl(const QUrl& url) const;
+
+    /** Number of calendars, and the calendar at a position between 0 and size(). */
+    int size() const { return _calendars.size(); }
+    Calendar* at(int index) const { return _calendars[index]; }
+
+    /** All calendars, in no particular order. */
+    const QVector<Calendar*>& calendars() const { return _calendars; }
+
+    /** Reduces a URL to the form used for duplicate detection: lowercase scheme and
+      * host, no default port, no fragment and no trailing slash. */
+    static QString normalizeUrl(const QUrl& url);
+private:
+    QVector<Calendar*> _calendars;
+
+    /** Position of every calendar in _calendars, by ID. */
+    QHash<int, int> _indices;
+
+    /** ID of every calendar, by normalized URL. */
+    QHash<QString, int> _urls;
+};
+
+#endif // CALENDARREGISTRY_H
@@ -0,0 +1,40 @@
+#include "calendarshard.h"
+
+#include "logger.h"
+#include "calendar.h"
+#include <cassert>
+
+LogCategory CalendarShard::CLASSNAME("CalendarShard");
+
+CalendarShard::CalendarShard(QObject* parent) :
+    QThread(parent)
+{
+    _load = 0;
+    _reaper = new CalendarReaper();
+    _reaper->moveToThread(this);
+    start();
+}
+
+CalendarShard::~CalendarShard()
+{
+    assert(_load == 0);
+    quit();
+    wait();
+    delete _reaper;
+}
+
+void CalendarShard::adopt(Calendar* cal)
+{
+    assert(cal);
+    cal->moveToThread(this);
+    ++_load;
+    LOG_DEBUG(CLASSNAME, this, LogMessage("Adopted calendar %1").arg(cal->url()));
+}
+
+void CalendarShard::destroy(Calendar* cal)
+{
+    assert(cal && cal->thread() == this);
+    QMetaObject::invokeMethod(_reaper, "destroy", Qt::BlockingQueuedConnection,
+                              Q_ARG(QObject*, cal));
+    --_load;
+}
@@ -0,0 +1,52 @@
+#ifndef CALENDARSHARD_H
+#define CALENDARSHARD_H
+
+#include "logger.h"
+#include <QObject>
+#include <QThread>
+
+class Calendar;
+class CalendarReaper;
+
+/**
+  * A worker thread that runs the event loop for a share of the calendars. Each
+  * calendar handles its mailbox on the shard it was adopted by, so calendars on
+  * different shards never wait for each other.
+  * \author Pieter De Decker
+  */
+class CalendarShard : public QThread
+{
+    Q_OBJECT
+public:
+    CalendarShard(QObject* parent = 0);
+
+    /** Stops the event loop. Calendars must have been destroyed by then. */
+    ~CalendarShard();
+
+    /** Moves a calendar (created on the calling thread) to this shard. */
+    void adopt(Calendar* cal);
+
+    /** Deletes an adopted calendar on this shard's thread and waits until it's gone. */
+    void destroy(Calendar* cal);
+
+    /** Number of calendars currently running on this shard. */
+    int load() const { return _load; }
+private:
+    static LogCategory CLASSNAME;
+
+    /** Lives on the shard thread and deletes calendars there. */
+    CalendarReaper* _reaper;
+    int _load;
+};
+
+/**
+  * Helper for CalendarShard: QObjects have to be deleted on their own thread.
+  */
+class CalendarReaper : public QObject
+{
+    Q_OBJECT
+public slots:
+    void destroy(QObject* obj) { delete obj; }
+};
+
+#endif // CALENDARSHARD_H
@@ -0,0 +1,229 @@
+#include "configstore.h"
+
+#include "fileutil.h"
+#include <cassert>
+#include <algorithm>
+
+LogCategory ConfigStore::CLASSNAME("ConfigStore");
+const int ConfigStore::COMPACTTHRESHOLD = 256;
+const char* ConfigStore::SNAPSHOTHEADER = "# AptNotifier calendars v1";
+
+ConfigStore::ConfigStore(const QString& basePath)
+    : _basePath(basePath), _journal(basePath + ".journal")
+{
+    _journalEntries = 0;
+    _nextId = 1;
+}
+
+ConfigStore::~ConfigStore()
+{
+    _journal.close();
+}
+
+void ConfigStore::load() {
+    _calendars.clear();
+    _settings.clear();
+    _nextId = 1;
+
+    // The snapshot is replaced atomically, so it's either complete or absent
+    QFile snapshot(_basePath + ".snapshot");
+    bool haveSnapshot = snapshot.open(QIODevice::ReadOnly);
+    if (haveSnapshot) {
+        if (snapshot.readLine().trimmed() != SNAPSHOTHEADER) {
+            LOG_ERROR(CLASSNAME, NULL, LogMessage("%1 has an unknown format").arg(snapshot.fileName()));
+        } else {
+            while (!snapshot.atEnd())
+                apply(snapshot.readLine().trimmed());
+        }
+        snapshot.close();
+    }
+
+    int replayed = replayJournal();
+
+    // Older versions kept a plain list of URLs under the base path
+    QFile legacy(_basePath);
+    if (!haveSnapshot && replayed == 0 && legacy.open(QIODevice::ReadOnly)) {
+        LOG_INFO(CLASSNAME, NULL, LogMessage("Importing calendar list from %1").arg(_basePath));
+        while (!legacy.atEnd()) {
+            CalendarConfig config;
+            config.url = QString(legacy.readLine()).trimmed();
+            if (!config.url.isEmpty()) {
+                config.id = _nextId++;
+                _calendars.insert(config.id, config);
+            }
+        }
+        legacy.close();
+        replayed = _calendars.size();
+    }
+
+    // Fold the journal into a fresh snapshot so it starts out empty. This also
+    // gets rid of a torn entry at its end, which would hide later appends.
+    if (replayed > 0 || QFile(_journal.fileName()).size() > 0)
+        compact();
+    else
+        openJournal(false);
+
+    // Only retire the old list once the snapshot holds its contents
+    if (legacy.exists() && QFile::exists(_basePath + ".snapshot"))
+        FileUtil::replaceFile(_basePath, _basePath + ".imported");
+
+    LOG_INFO(CLASSNAME, NULL, LogMessage("Loaded %1 calendars, replayed %2 journal entries")
+             .arg(_calendars.size()).arg(replayed));
+}
+
+bool ConfigStore::find(int id, CalendarConfig& config) const {
+    QMap<int, CalendarConfig>::const_iterator it = _calendars.find(id);
+    if (it == _calendars.end())
+        return false;
+
+    config = *it;
+    return true;
+}
+
+void ConfigStore::add(CalendarConfig& config) {
+    config.id = _nextId++;
+    _calendars.insert(config.id, config);
+    append(putEntry(config));
+}
+
+void ConfigStore::update(const CalendarConfig& config) {
+    assert(_calendars.contains(config.id));
+    _calendars.insert(config.id, config);
+    append(putEntry(config));
+}
+
+void ConfigStore::remove(int id) {
+    if (_calendars.remove(id) > 0)
+        append("del\t" + QByteArray::number(id));
+}
+
+void ConfigStore::setSetting(const QString& key, int value) {
+    if (_settings.contains(key) && _settings[key] == value)
+        return;
+
+    _settings.insert(key, value);
+    append("set\t" + key.toUtf8() + '\t' + QByteArray::number(value));
+}
+
+void ConfigStore::compact() {
+    QByteArray data = QByteArray(SNAPSHOTHEADER) + '\n';
+    data += "nextid\t" + QByteArray::number(_nextId) + '\n';
+    for (QMap<QString, int>::const_iterator it = _settings.constBegin(); it != _settings.constEnd(); ++it)
+        data += "set\t" + it.key().toUtf8() + '\t' + QByteArray::number(*it) + '\n';
+    foreach (const CalendarConfig& config, _calendars)
+        data += putEntry(config) + '\n';
+
+    // The journal may only be emptied once the snapshot holds its changes
+    if (!FileUtil::writeAtomically(_basePath + ".snapshot", data)) {
+        LOG_ERROR(CLASSNAME, NULL, "Couldn't write snapshot, keeping the journal");
+        openJournal(false);
+        return;
+    }
+
+    openJournal(true);
+    _journalEntries = 0;
+    LOG_DEBUG(CLASSNAME, NULL, LogMessage("Compacted %1 calendars").arg(_calendars.size()));
+}
+
+bool ConfigStore::apply(const QByteArray& entry) {
+    QList<QByteArray> fields = entry.split('\t');
+    bool ok = false;
+
+    if (fields.size() == 2 && fields[0] == "nextid") {
+        int nextId = fields[1].toInt(&ok);
+        if (ok)
+            _nextId = std::max(_nextId, nextId);
+    } else if (fields.size() == 3 && fields[0] == "set") {
+        int value = fields[2].toInt(&ok);
+        if (ok)
+            _settings.insert(QString::fromUtf8(fields[1]), value);
+    } else if (fields.size() == 2 && fields[0] == "del") {
+        int id = fields[1].toInt(&ok);
+        if (ok) {
+            _calendars.remove(id);
+            _nextId = std::max(_nextId, id + 1);
+        }
+    } else if (fields.size() == 9 && fields[0] == "put") {
+        // put, ID, URL, color, refresh limits, ETag, Last-Modified and checksum
+        CalendarConfig config;
+        config.id = fields[1].toInt(&ok);
+        config.url = QString::fromUtf8(QByteArray::fromPercentEncoding(fields[2]));
+        config.color = QString(fields[3]);
+        config.minRefresh = fields[4].toInt();
+        config.maxRefresh = fields[5].toInt();
+        config.etag = QByteArray::fromPercentEncoding(fields[6]);
+        config.lastModified = QByteArray::fromPercentEncoding(fields[7]);
+        config.checksum = fields[8].toInt();
+        if (ok) {
+            _calendars.insert(config.id, config);
+            _nextId = std::max(_nextId, config.id + 1);
+        }
+    }
+
+    return ok;
+}
+
+void ConfigStore::append(const QByteArray& entry) {
+    QByteArray line = QByteArray::number(lineChecksum(entry), 16) + '\t' + entry + '\n';
+
+    // One small write per change; flush so another process (or a crash) sees it
+    if (!_journal.isOpen() || _journal.write(line) != line.size() || !_journal.flush())
+        LOG_ERROR(CLASSNAME, NULL, "Couldn't append to the journal");
+
+    if (++_journalEntries >= COMPACTTHRESHOLD)
+        compact();
+}
+
+int ConfigStore::replayJournal() {
+    QFile journal(_basePath + ".journal");
+    if (!journal.open(QIODevice::ReadOnly))
+        return 0;
+
+    int replayed = 0;
+    while (!journal.atEnd()) {
+        QByteArray line = journal.readLine();
+
+        // A line without its newline or with a bad checksum was being written
+        // when we crashed. Nothing after it can be trusted.
+        int tab = line.indexOf('\t');
+        if (!line.endsWith('\n') || tab < 0) {
+            LOG_WARNING(CLASSNAME, NULL, "Ignoring torn journal entry");
+            break;
+        }
+
+        QByteArray entry = line.mid(tab + 1, line.size() - tab - 2);
+        bool ok;
+        quint32 checksum = line.left(tab).toUInt(&ok, 16);
+        if (!ok || checksum != lineChecksum(entry) || !apply(entry)) {
+            LOG_WARNING(CLASSNAME, NULL, "Ignoring corrupt journal entry");
+            break;
+        }
+        ++replayed;
+    }
+
+    return replayed;
+}
+
+QByteArray ConfigStore::putEntry(const CalendarConfig& config) {
+    return "put\t" + QByteArray::number(config.id) + '\t' + config.url.toUtf8().toPercentEncoding()
+            + '\t' + config.color.toAscii() + '\t' + QByteArray::number(config.minRefresh)
+            + '\t' + QByteArray::number(config.maxRefresh) + '\t' + config.etag.toPercentEncoding()
+            + '\t' + config.lastModified.toPercentEncoding() + '\t' + QByteArray::number(config.checksum);
+}
+
+quint32 ConfigStore::lineChecksum(const QByteArray& entry) {
+    // FNV-1a
+    quint32 hash = 2166136261u;
+    for (int i = 0; i < entry.size(); ++i) {
+        hash ^= (uchar)entry[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void ConfigStore::openJournal(bool truncate) {
+    _journal.close();
+    QIODevice::OpenMode mode = QIODevice::WriteOnly | (truncate ? QIODevice::Truncate : QIODevice::Append);
+    if (!_journal.open(mode))
+        LOG_ERROR(CLASSNAME, NULL, LogMessage("Couldn't open %1, changes won't be saved").arg(_journal.fileName()));
+}
@@ -0,0 +1,112 @@
+#ifndef CONFIGSTORE_H
+#define CONFIGSTORE_H
+
+#include "logger.h"
+#include <QMap>
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+
+/**
+  * Everything AptNotifier remembers about a calendar between sessions.
+  */
+struct CalendarConfig {
+    CalendarConfig() : id(0), minRefresh(0), maxRefresh(0), checksum(0) {}
+
+    /** Stable identifier, assigned by ConfigStore::add and never reused. */
+    int id;
+    QString url;
+
+    /** Color tag as "#rrggbb", or empty if none was picked yet. */
+    QString color;
+
+    /** Freshness lifetime bounds in seconds, or 0 to use the global ones. */
+    int minRefresh;
+    int maxRefresh;
+
+    /** Validators and checksum of the last successful download. */
+    QByteArray etag;
+    QByteArray lastModified;
+    int checksum;
+};
+
+/**
+  * Persists the calendar list as a snapshot plus an append-only journal. Every
+  * change appends one line to the journal, so changing a calendar costs O(1) I/O
+  * no matter how many calendars there are. Journal lines carry a checksum: a line
+  * that was cut short by a crash is ignored when loading. Once the journal grows
+  * past COMPACTTHRESHOLD entries, the store writes a fresh snapshot atomically
+  * and starts an empty journal.
+  * \author Pieter De Decker
+  */
+class ConfigStore
+{
+public:
+    /** Creates a store whose files start with 'basePath' (".snapshot" and ".journal"
+      * are appended). Call load() before using it. */
+    ConfigStore(const QString& basePath = "calendars");
+    ~ConfigStore();
+
+    /** Reads the snapshot and replays the journal. Imports the plain URL list of
+      * older versions if there is no snapshot yet. */
+    void load();
+
+    /** All calendars, ordered by ID. */
+    QList<CalendarConfig> calendars() const { return _calendars.values(); }
+
+    /** Returns true and fills in 'config' if a calendar with this ID exists. */
+    bool find(int id, CalendarConfig& config) const;
+
+    /** Assigns a new ID to 'config' and stores it. */
+    void add(CalendarConfig& config);
+
+    /** Hands out a new ID without storing anything, for calendars that aren't saved. */
+    int reserveId() { return _nextId++; }
+
+    /** Replaces the stored version of a calendar. */
+    void update(const CalendarConfig& config);
+
+    /** Forgets a calendar. */
+    void remove(int id);
+
+    /** Global setting 'key', or 'defaultValue' if it was never set. */
+    int setting(const QString& key, int defaultValue) const { return _settings.value(key, defaultValue); }
+
+    /** Stores a global setting. Keys can't contain whitespace. */
+    void setSetting(const QString& key, int value);
+
+    /** Writes a snapshot of the current state and empties the journal. */
+    void compact();
+
+    static const int COMPACTTHRESHOLD;
+private:
+    static LogCategory CLASSNAME;
+    static const char* SNAPSHOTHEADER;
+
+    /** Applies a single snapshot or journal entry. Returns false if it's malformed. */
+    bool apply(const QByteArray& entry);
+
+    /** Appends an entry to the journal and compacts if it grew too long. */
+    void append(const QByteArray& entry);
+
+    /** Reads the journal and applies every intact line. Returns the number applied. */
+    int replayJournal();
+
+    /** Builds the "put" entry for a calendar. */
+    static QByteArray putEntry(const CalendarConfig& config);
+
+    /** Checksum that protects journal lines against torn writes. */
+    static quint32 lineChecksum(const QByteArray& entry);
+
+    /** Opens the journal for appending, truncating it if requested. */
+    void openJournal(bool truncate);
+
+    QString _basePath;
+    QMap<int, CalendarConfig> _calendars;
+    QMap<QString, int> _settings;
+    QFile _journal;
+    int _journalEntries;
+    int _nextId;
+};
+
+#endif // CONFIGSTORE_H
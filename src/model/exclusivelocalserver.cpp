@@ -0,0 +1,67 @@
+#include "exclusivelocalserver.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocalSocket>
+#include <QCoreApplication>
+
+LogCategory ExclusiveLocalServer::CLASSNAME("ExclusiveLocalServer");
+const int ExclusiveLocalServer::PROBETIMEOUT = 500;
+
+ExclusiveLocalServer::ExclusiveLocalServer(QObject* parent)
+    : QLocalServer(parent)
+{
+}
+
+ExclusiveLocalServer::~ExclusiveLocalServer() {
+    // A newer instance may have replaced our symlink; leave theirs alone. Closing
+    // the server afterwards only removes our private path.
+    if (!_publishedPath.isEmpty() && QFileInfo(_publishedPath).symLinkTarget() == fullServerName())
+        QFile::remove(_publishedPath);
+}
+
+bool ExclusiveLocalServer::listenExclusive(const QString& name) {
+    // Don't take the name from an instance that still answers
+    {
+        QLocalSocket probe;
+        probe.connectToServer(name);
+        if (probe.waitForConnected(PROBETIMEOUT)) {
+            LOG_WARNING(CLASSNAME, this, LogMessage("%1 is in use by another instance").arg(name));
+            return false;
+        }
+    }
+
+#ifdef Q_OS_UNIX
+    QString path = name.startsWith('/') ? name : QDir::tempPath() + '/' + name;
+    QFileInfo published(path);
+    if (published.exists() || published.isSymLink()) {
+        LOG_INFO(CLASSNAME, this, LogMessage("Replacing stale socket %1").arg(path));
+        QFile::remove(path);
+    }
+
+    // No live process has our PID, so whatever is at the private path is stale
+    QString privatePath = path + '.' + QString::number(QCoreApplication::applicationPid());
+    QFile::remove(privatePath);
+    if (!listen(privatePath))
+        return false;
+
+    // Fails if another instance published the name after we probed it
+    if (!QFile::link(privatePath, path)) {
+        LOG_WARNING(CLASSNAME, this, LogMessage("%1 was claimed by another instance").arg(name));
+        close();
+        return false;
+    }
+    _publishedPath = path;
+    return true;
+#else
+    return listen(name);
+#endif
+}
+
+QString ExclusiveLocalServer::perUserName(const QString& base) {
+    QString user = QString::fromLocal8Bit(qgetenv("USER"));
+    if (user.isEmpty())
+        user = QString::fromLocal8Bit(qgetenv("USERNAME"));
+    return user.isEmpty() ? base : base + '-' + user;
+}
@@ -0,0 +1,45 @@
+#ifndef EXCLUSIVELOCALSERVER_H
+#define EXCLUSIVELOCALSERVER_H
+
+#include "logger.h"
+#include <QString>
+#include <QLocalServer>
+
+/**
+  * A QLocalServer for a well-known name that several processes may compete for.
+  * It never takes the name away from an instance that still answers, and never
+  * deletes a socket that belongs to someone else.
+  *
+  * On UNIX, a plain QLocalServer unlinks its socket file when it closes, even if
+  * another process has replaced it in the meantime. This class listens on a path
+  * private to the process instead and publishes the name as a symlink to it. On
+  * destruction, the symlink is only removed if it still points at us. Named pipes
+  * on Windows disappear with their owner, so there the name is used directly.
+  * \author Pieter De Decker
+  */
+class ExclusiveLocalServer : public QLocalServer
+{
+    Q_OBJECT
+public:
+    ExclusiveLocalServer(QObject* parent = 0);
+    ~ExclusiveLocalServer();
+
+    /** Starts listening on 'name'. A socket left behind by a crashed instance is
+      * replaced, but only after connecting to it failed. Returns false if another
+      * instance owns the name or listening fails. */
+    bool listenExclusive(const QString& name);
+
+    /** Returns 'base' followed by the name of the user, so that users sharing a
+      * host don't compete for the same socket. */
+    static QString perUserName(const QString& base);
+
+    /** How long we try to reach an existing socket before declaring it stale. */
+    static const int PROBETIMEOUT;
+private:
+    static LogCategory CLASSNAME;
+
+    /** The symlink we published, empty if none. */
+    QString _publishedPath;
+};
+
+#endif // EXCLUSIVELOCALSERVER_H
@@ -0,0 +1,161 @@
+#include "fetchscheduler.h"
+
+#include "httpdownloader.h"
+#include <cassert>
+#include <algorithm>
+#include <QMetaObject>
+
+const int FetchScheduler::DEFAULTMAXINFLIGHT = 8;
+const int FetchScheduler::DEFAULTMAXPERHOST = 2;
+FetchScheduler FetchScheduler::instancePtr;
+
+FetchScheduler::FetchScheduler()
+{
+    _maxInFlight = DEFAULTMAXINFLIGHT;
+    _maxPerHost = DEFAULTMAXPERHOST;
+    _peakQueueDepth = 0;
+    _dispatched = 0;
+    _totalWaitMs = 0;
+    _maxWaitMs = 0;
+}
+
+FetchScheduler* FetchScheduler::instance() {
+    return &instancePtr;
+}
+
+void FetchScheduler::enqueue(HttpDownloader* dl, const QUrl& url, Priority priority) {
+    assert(dl);
+    assert(0 <= priority && priority < PriorityCount);
+    _lock.lock();
+
+    // If the downloader already waits in a queue, promote it instead of queueing twice
+    bool alreadyQueued = false;
+    for (int prio = 0; prio < PriorityCount && !alreadyQueued; ++prio) {
+        for (QList<Request>::iterator it = _queues[prio].begin(); it != _queues[prio].end(); ++it) {
+            if (it->dl == dl) {
+                alreadyQueued = true;
+                if (prio < priority) {
+                    _queues[priority].append(*it);
+                    _queues[prio].erase(it);
+                }
+                break;
+            }
+        }
+    }
+
+    if (!alreadyQueued) {
+        Request request;
+        request.dl = dl;
+        request.url = url;
+        request.queued.start();
+        _queues[priority].append(request);
+    }
+
+    int queueDepth = 0;
+    for (int prio = 0; prio < PriorityCount; ++prio)
+        queueDepth += _queues[prio].size();
+    _peakQueueDepth = std::max(_peakQueueDepth, queueDepth);
+
+    dispatch();
+    _lock.unlock();
+}
+
+void FetchScheduler::finished(HttpDownloader* dl) {
+    _lock.lock();
+    QHash<HttpDownloader*, QString>::iterator it = _inFlight.find(dl);
+    if (it != _inFlight.end()) {
+        if (--_inFlightPerHost[it.value()] == 0)
+            _inFlightPerHost.remove(it.value());
+        _inFlight.erase(it);
+    }
+
+    dispatch();
+    _lock.unlock();
+}
+
+void FetchScheduler::cancel(HttpDownloader* dl) {
+    _lock.lock();
+    for (int prio = 0; prio < PriorityCount; ++prio) {
+        for (QList<Request>::iterator it = _queues[prio].begin(); it != _queues[prio].end();) {
+            if (it->dl == dl)
+                it = _queues[prio].erase(it);
+            else
+                ++it;
+        }
+    }
+    _lock.unlock();
+
+    // Give back the slot of an in-flight request, if any
+    finished(dl);
+}
+
+void FetchScheduler::setLimits(int maxInFlight, int maxPerHost) {
+    assert(maxInFlight >= 1 && maxPerHost >= 1);
+    _lock.lock();
+    _maxInFlight = maxInFlight;
+    _maxPerHost = maxPerHost;
+    dispatch();
+    _lock.unlock();
+}
+
+FetchScheduler::Stats FetchScheduler::stats() {
+    Stats retVal;
+
+    _lock.lock();
+    retVal.queueDepth = 0;
+    for (int prio = 0; prio < PriorityCount; ++prio)
+        retVal.queueDepth += _queues[prio].size();
+    retVal.peakQueueDepth = _peakQueueDepth;
+    retVal.inFlight = _inFlight.size();
+    retVal.dispatched = _dispatched;
+    retVal.avgWaitMs = (_dispatched > 0) ? (int)(_totalWaitMs/_dispatched) : 0;
+    retVal.maxWaitMs = _maxWaitMs;
+    _lock.unlock();
+
+    return retVal;
+}
+
+QString FetchScheduler::statsString() {
+    Stats s = stats();
+    return "queued " + QString::number(s.queueDepth) + " (peak " + QString::number(s.peakQueueDepth)
+            + "), in flight " + QString::number(s.inFlight) + ", dispatched " + QString::number(s.dispatched)
+            + ", wait avg " + QString::number(s.avgWaitMs) + " ms / max " + QString::number(s.maxWaitMs) + " ms";
+}
+
+void FetchScheduler::dispatch() {
+    Request next;
+    while (_inFlight.size() < _maxInFlight && takeNext(next)) {
+        QString host = next.url.host();
+        _inFlight[next.dl] = host;
+        ++_inFlightPerHost[host];
+
+        // Update wait time statistics
+        int waitMs = (int)next.queued.elapsed();
+        ++_dispatched;
+        _totalWaitMs += waitMs;
+        _maxWaitMs = std::max(_maxWaitMs, waitMs);
+
+        // Start the request on the thread that owns the downloader
+        QMetaObject::invokeMethod(next.dl, "startGet", Qt::QueuedConnection, Q_ARG(QUrl, next.url));
+    }
+}
+
+bool FetchScheduler::takeNext(Request& next) {
+    for (int prio = PriorityCount - 1; prio >= 0; --prio) {
+        for (QList<Request>::iterator it = _queues[prio].begin(); it != _queues[prio].end(); ++it) {
+            // A downloader only has one request in flight at a time
+            if (_inFlight.contains(it->dl))
+                continue;
+
+            // Skip hosts that are at their limit, so they don't block other hosts
+            if (_inFlightPerHost.value(it->url.host(), 0) >= _maxPerHost)
+                continue;
+
+            next = *it;
+            _queues[prio].erase(it);
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,98 @@
+#ifndef FETCHSCHEDULER_H
+#define FETCHSCHEDULER_H
+
+#include <QUrl>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QElapsedTimer>
+
+class HttpDownloader;
+
+/**
+  * Queues GET requests from all HttpDownloaders and dispatches them while respecting
+  * a global and a per-host concurrency limit. Requests with a higher priority are
+  * dispatched first. All functions in this class are thread-safe.
+  * \author Pieter De Decker
+  */
+class FetchScheduler
+{
+private:
+    FetchScheduler();
+public:
+    static FetchScheduler* instance();
+
+    /** PRIORITY CLASSES FOR REQUESTS
+      *
+      * Background
+      *     Automatic refresh after a calendar's freshness lifetime ran out.
+      * ReminderDue
+      *     Automatic refresh of a calendar that has reminders or events coming up soon.
+      * Manual
+      *     Refresh explicitly requested by the user.
+      */
+    enum Priority { Background, ReminderDue, Manual, PriorityCount };
+
+    /** Queue statistics since startup. Wait times are measured from enqueue to dispatch. */
+    struct Stats {
+        int queueDepth;
+        int peakQueueDepth;
+        int inFlight;
+        int dispatched;
+        int avgWaitMs;
+        int maxWaitMs;
+    };
+
+    /** Queues a GET request for a downloader. If the downloader already has a request
+      * queued, that request is reused and promoted to the highest of both priorities. */
+    void enqueue(HttpDownloader* dl, const QUrl& url, Priority priority);
+
+    /** Reports that the request of a downloader has returned, freeing up its slot. */
+    void finished(HttpDownloader* dl);
+
+    /** Drops queued requests and in-flight slots of a downloader that is being destroyed. */
+    void cancel(HttpDownloader* dl);
+
+    /** Changes the concurrency limits. Both limits must be at least 1. */
+    void setLimits(int maxInFlight, int maxPerHost);
+
+    /** Returns a snapshot of the queue statistics. */
+    Stats stats();
+
+    /** Returns a one-line summary of the queue statistics, for logging. */
+    QString statsString();
+
+    static const int DEFAULTMAXINFLIGHT;
+    static const int DEFAULTMAXPERHOST;
+private:
+    struct Request {
+        HttpDownloader* dl;
+        QUrl url;
+        QElapsedTimer queued;
+    };
+
+    /** Starts as many queued requests as the limits allow. _lock must be held. */
+    void dispatch();
+
+    /** Takes the first request of the highest priority whose host has a free slot out of
+      * the queues. Returns false if no request can be started. _lock must be held. */
+    bool takeNext(Request& next);
+
+    static FetchScheduler instancePtr;
+
+    QMutex _lock;
+    QList<Request> _queues[PriorityCount];
+    QHash<HttpDownloader*, QString> _inFlight;
+    QHash<QString, int> _inFlightPerHost;
+    int _maxInFlight;
+    int _maxPerHost;
+
+    // Statistics
+    int _peakQueueDepth;
+    int _dispatched;
+    qint64 _totalWaitMs;
+    int _maxWaitMs;
+};
+
+#endif // FETCHSCHEDULER_H
@@ -0,0 +1,57 @@
+#include "fileutil.h"
+
+#include "logger.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryFile>
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <cstdio>
+#include <unistd.h>
+#endif
+
+LogCategory FileUtil::CLASSNAME("FileUtil");
+
+bool FileUtil::writeAtomically(const QString& path, const QByteArray& data) {
+    // The temporary file must live on the same file system as the target,
+    // otherwise the final rename can't be atomic.
+    QTemporaryFile tmp(path + ".XXXXXX");
+    tmp.setAutoRemove(false);
+    if (!tmp.open()) {
+        LOG_WARNING(CLASSNAME, NULL, LogMessage("Couldn't create temporary file for %1").arg(path));
+        return false;
+    }
+
+    bool ok = (tmp.write(data) == data.size()) && tmp.flush();
+
+    // Make sure the data hits the disk before the rename makes it visible
+    if (ok) {
+#ifdef Q_OS_WIN
+        ok = (_commit(tmp.handle()) == 0);
+#else
+        ok = (fsync(tmp.handle()) == 0);
+#endif
+    }
+
+    QString tmpName = tmp.fileName();
+    tmp.close();
+    if (!ok || !replaceFile(tmpName, path)) {
+        LOG_WARNING(CLASSNAME, NULL, LogMessage("Couldn't write %1 atomically").arg(path));
+        QFile::remove(tmpName);
+        return false;
+    }
+
+    return true;
+}
+
+bool FileUtil::replaceFile(const QString& from, const QString& to) {
+#ifdef Q_OS_WIN
+    return MoveFileExW((const wchar_t*)QFileInfo(from).absoluteFilePath().utf16(),
+                       (const wchar_t*)QFileInfo(to).absoluteFilePath().utf16(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+}
@@ -0,0 +1,28 @@
+#ifndef FILEUTIL_H
+#define FILEUTIL_H
+
+#include "logger.h"
+#include <QString>
+#include <QByteArray>
+
+/**
+  * File system helpers shared by the classes that persist data to disk.
+  * \author Pieter De Decker
+  */
+class FileUtil
+{
+public:
+    /** Replaces the contents of 'path' with 'data' in a way that survives crashes: the
+      * data is written to a temporary file in the same directory, synced to disk and
+      * then renamed over the target. Readers see either the old or the new contents,
+      * never a truncated file. Returns false if any step fails. */
+    static bool writeAtomically(const QString& path, const QByteArray& data);
+
+    /** Atomically renames 'from' to 'to', replacing 'to' if it exists. Unlike
+      * QFile::rename, this doesn't fail when the target already exists. */
+    static bool replaceFile(const QString& from, const QString& to);
+private:
+    static LogCategory CLASSNAME;
+};
+
+#endif // FILEUTIL_H
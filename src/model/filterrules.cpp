@@ -0,0 +1,251 @@
+#include "filterrules.h"
+
+#include <QFile>
+#include <QQueue>
+
+LogCategory FilterRules::CLASSNAME("FilterRules");
+const char* FilterRules::DEFAULTPATH = "filters";
+
+FilterRules::FilterRules()
+{
+    _states.append(State());
+}
+
+int FilterRules::load(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        compile(QString());
+        return 0;
+    }
+
+    QStringList errors;
+    int count = compile(QString::fromUtf8(file.readAll()), &errors);
+    foreach (const QString& error, errors)
+        LOG_WARNING(CLASSNAME, NULL, LogMessage("%1: %2").arg(path).arg(error));
+    LOG_INFO(CLASSNAME, NULL, LogMessage("Loaded %1 notification filters from %2").arg(count).arg(path));
+    return count;
+}
+
+int FilterRules::compile(const QString& text, QStringList* errors) {
+    _rules.clear();
+    _patterns.clear();
+    _transitions.clear();
+    _states.clear();
+    _states.append(State());
+
+    QStringList lines = text.split('\n');
+    for (int i = 0; i < lines.size(); ++i) {
+        QString line = lines[i].trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        Rule rule;
+        QString error;
+        if (parseRule(line, rule, error))
+            _rules.append(rule);
+        else if (errors)
+            errors->append(QString("line %1: %2").arg(i + 1).arg(error));
+    }
+
+    buildAutomaton();
+    return _rules.size();
+}
+
+Appointment::Priority FilterRules::classify(int calendarId, const Appointment& apt) const {
+    if (_rules.isEmpty())
+        return Appointment::Normal;
+
+    // One pass over the summary finds every pattern it contains
+    QVector<bool> matched(_patterns.size(), false);
+    if (!_patterns.isEmpty()) {
+        const QString& summary = apt.summary();
+        int state = 0;
+        for (int i = 0; i < summary.size(); ++i) {
+            QChar c = summary[i].toLower();
+            int next = transition(state, c);
+            while (next < 0 && state != 0) {
+                state = _states[state].fail;
+                next = transition(state, c);
+            }
+            state = (next < 0) ? 0 : next;
+            foreach (int pattern, _states[state].outputs)
+                matched[pattern] = true;
+        }
+    }
+
+    int minutes = apt.start().secsTo(apt.end())/60;
+    int startMinute = apt.start().time().hour()*60 + apt.start().time().minute();
+    bool dayWide = apt.isDayWide();
+
+    foreach (const Rule& rule, _rules) {
+        if (rule.calendarId != -1 && rule.calendarId != calendarId)
+            continue;
+        if (rule.pattern != -1 && !matched[rule.pattern])
+            continue;
+        if (rule.dayWide != -1 && rule.dayWide != int(dayWide))
+            continue;
+        if (rule.minMinutes != -1 && minutes < rule.minMinutes)
+            continue;
+        if (rule.maxMinutes != -1 && minutes > rule.maxMinutes)
+            continue;
+        if (rule.fromMinute != -1) {
+            bool inRange = (rule.fromMinute <= rule.toMinute)
+                    ? (rule.fromMinute <= startMinute && startMinute < rule.toMinute)
+                    : (rule.fromMinute <= startMinute || startMinute < rule.toMinute);
+            if (!inRange)
+                continue;
+        }
+        return rule.action;
+    }
+
+    return Appointment::Normal;
+}
+
+bool FilterRules::parseRule(const QString& line, Rule& rule, QString& error) {
+    QStringList words = splitWords(line);
+    if (words.isEmpty()) {
+        error = "empty rule";
+        return false;
+    }
+
+    QString action = words.takeFirst().toLower();
+    if (action == "mute") {
+        rule.action = Appointment::Muted;
+    } else if (action == "escalate") {
+        rule.action = Appointment::Escalated;
+    } else if (action == "notify") {
+        rule.action = Appointment::Normal;
+    } else {
+        error = "unknown action '" + action + "'";
+        return false;
+    }
+
+    foreach (const QString& word, words) {
+        int eq = word.indexOf('=');
+        QString key = (eq < 0) ? word.toLower() : word.left(eq).toLower();
+        QString value = (eq < 0) ? QString() : word.mid(eq + 1);
+        bool valid = true;
+
+        if (key == "daywide" && eq < 0) {
+            rule.dayWide = 1;
+        } else if (key == "!daywide" && eq < 0) {
+            rule.dayWide = 0;
+        } else if (key == "calendar") {
+            rule.calendarId = value.toInt(&valid);
+        } else if (key == "summary") {
+            valid = !value.isEmpty();
+            if (valid)
+                rule.pattern = addPattern(value.toLower());
+        } else if (key == "minduration") {
+            rule.minMinutes = value.toInt(&valid);
+            valid = valid && rule.minMinutes >= 0;
+        } else if (key == "maxduration") {
+            rule.maxMinutes = value.toInt(&valid);
+            valid = valid && rule.maxMinutes >= 0;
+        } else if (key == "time") {
+            QStringList range = value.split('-');
+            valid = range.size() == 2;
+            if (valid) {
+                rule.fromMinute = parseTimeOfDay(range[0]);
+                rule.toMinute = parseTimeOfDay(range[1]);
+                valid = rule.fromMinute != -1 && rule.toMinute != -1;
+            }
+        } else {
+            error = "unknown condition '" + word + "'";
+            return false;
+        }
+
+        if (!valid) {
+            error = "bad value in '" + word + "'";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QStringList FilterRules::splitWords(const QString& line) {
+    QStringList words;
+    QString word;
+    bool quoted = false;
+    for (int i = 0; i < line.size(); ++i) {
+        QChar c = line[i];
+        if (c == '"') {
+            quoted = !quoted;
+        } else if (c.isSpace() && !quoted) {
+            if (!word.isEmpty())
+                words.append(word);
+            word.clear();
+        } else {
+            word += c;
+        }
+    }
+    if (!word.isEmpty())
+        words.append(word);
+    return words;
+}
+
+int FilterRules::parseTimeOfDay(const QString& text) {
+    QStringList parts = text.split(':');
+    if (parts.size() != 2)
+        return -1;
+
+    bool hourValid, minuteValid;
+    int hour = parts[0].toInt(&hourValid);
+    int minute = parts[1].toInt(&minuteValid);
+    if (!hourValid || !minuteValid || hour < 0 || hour > 24 || minute < 0 || minute > 59 || hour*60 + minute > 24*60)
+        return -1;
+    return hour*60 + minute;
+}
+
+int FilterRules::addPattern(const QString& pattern) {
+    int index = _patterns.indexOf(pattern);
+    if (index != -1)
+        return index;
+
+    index = _patterns.size();
+    _patterns.append(pattern);
+
+    // Extend the trie
+    int state = 0;
+    for (int i = 0; i < pattern.size(); ++i) {
+        int next = transition(state, pattern[i]);
+        if (next < 0) {
+            next = _states.size();
+            _states.append(State());
+            _transitions.insert((quint64(state) << 16) | pattern[i].unicode(), next);
+            _states[state].edges.append(qMakePair(pattern[i].unicode(), next));
+        }
+        state = next;
+    }
+    _states[state].outputs.append(index);
+    return index;
+}
+
+void FilterRules::buildAutomaton() {
+    // Breadth-first, so every fail link points to a state that's already done
+    QQueue<int> queue;
+    typedef QPair<ushort, int> Edge;
+    foreach (const Edge& edge, _states[0].edges) {
+        _states[edge.second].fail = 0;
+        queue.enqueue(edge.second);
+    }
+
+    while (!queue.isEmpty()) {
+        int state = queue.dequeue();
+        foreach (const Edge& edge, _states[state].edges) {
+            QChar c(edge.first);
+            int fail = _states[state].fail;
+            int next = transition(fail, c);
+            while (next < 0 && fail != 0) {
+                fail = _states[fail].fail;
+                next = transition(fail, c);
+            }
+
+            State& child = _states[edge.second];
+            child.fail = (next < 0) ? 0 : next;
+            child.outputs += _states[child.fail].outputs;
+            queue.enqueue(edge.second);
+        }
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef FILTERRULES_H
+#define FILTERRULES_H
+
+#include "logger.h"
+#include "appointment.h"
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include <QStringList>
+
+/**
+  * Decides which appointments are muted or escalated. Rules are read from a text
+  * file, one per line; lines starting with '#' are comments. A rule is an action
+  * followed by conditions, all of which must hold:
+  *
+  *   mute summary="focus time"
+  *   mute daywide
+  *   escalate calendar=3 summary=interview time=09:00-12:00
+  *   notify calendar=5 maxduration=30
+  *
+  * ACTIONS
+  *   mute              No notifications at all
+  *   escalate          Always shown on their own, never folded into a summary
+  *   notify            Delivered normally; makes exceptions to later rules
+  *
+  * CONDITIONS
+  *   calendar=<id>           Calendar ID
+  *   summary=<text>          Summary contains the text, ignoring case. Quote
+  *                           text with spaces.
+  *   daywide, !daywide       Appointment is or isn't day-wide
+  *   minduration=<minutes>   Lasts at least this long
+  *   maxduration=<minutes>   Lasts at most this long
+  *   time=<hh:mm>-<hh:mm>    Starts in this time of day; may wrap past midnight
+  *
+  * The first matching rule wins. Rules are compiled once: all summary texts go
+  * into one Aho-Corasick automaton, so classify() scans a summary once no matter
+  * how many rules there are. Calendars classify their appointments when they build
+  * their cache, not on every notification tick. Immutable after loading, so any
+  * thread may classify.
+  * \author Pieter De Decker
+  */
+class FilterRules
+{
+public:
+    FilterRules();
+
+    /** Replaces the rules with the ones in 'path'. A missing file means no rules.
+      * Lines with errors are logged and skipped. Returns the number of rules. */
+    int load(const QString& path = DEFAULTPATH);
+
+    /** Replaces the rules with the ones in 'text'. Lines with errors are skipped and
+      * described in 'errors', if given. Returns the number of rules. */
+    int compile(const QString& text, QStringList* errors = NULL);
+
+    bool isEmpty() const { return _rules.isEmpty(); }
+
+    /** [THREAD-SAFE] Returns the priority the first matching rule gives to 'apt'
+      * in calendar 'calendarId', or Appointment::Normal if none matches. */
+    Appointment::Priority classify(int calendarId, const Appointment& apt) const;
+
+    static const char* DEFAULTPATH;
+private:
+    static LogCategory CLASSNAME;
+
+    /** A compiled rule. Conditions that are -1 don't apply. */
+    struct Rule {
+        Rule() : action(Appointment::Normal), calendarId(-1), pattern(-1), dayWide(-1),
+            minMinutes(-1), maxMinutes(-1), fromMinute(-1), toMinute(-1) {}
+
+        Appointment::Priority action;
+        int calendarId;
+        int pattern;        // Index into the automaton's patterns
+        int dayWide;        // 0 or 1
+        int minMinutes;
+        int maxMinutes;
+        int fromMinute;     // Minutes after midnight
+        int toMinute;
+    };
+
+    /** A state of the Aho-Corasick automaton. */
+    struct State {
+        State() : fail(0) {}
+
+        int fail;
+        QVector<int> outputs;               // Patterns that end here, including via fail links
+        QList<QPair<ushort, int> > edges;   // Trie children, for building the fail links
+    };
+
+    /** Parses a single rule. Returns false and sets 'error' if it's malformed. */
+    bool parseRule(const QString& line, Rule& rule, QString& error);
+
+    /** Splits a rule into words; double quotes group words. */
+    static QStringList splitWords(const QString& line);
+
+    /** Parses "hh:mm" to minutes after midnight, or -1. */
+    static int parseTimeOfDay(const QString& text);
+
+    /** Returns the index of 'pattern', adding it to the trie if it's new. */
+    int addPattern(const QString& pattern);
+
+    /** Computes fail links and merges outputs once all patterns are in. */
+    void buildAutomaton();
+
+    /** Transition from 'state' on 'c', or -1. */
+    int transition(int state, QChar c) const {
+        return _transitions.value((quint64(state) << 16) | c.unicode(), -1);
+    }
+
+    QVector<Rule> _rules;
+    QStringList _patterns;
+    QVector<State> _states;
+
+    /** Trie edges, keyed by (state << 16) | character. */
+    QHash<quint64, int> _transitions;
+};
+
+#endif // FILTERRULES_H
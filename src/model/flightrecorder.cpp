@@ -0,0 +1,134 @@
+#include "flightrecorder.h"
+
+#include <cstring>
+#include <cassert>
+#include <QThread>
+#include <QDateTime>
+#include <QCoreApplication>
+
+LogCategory FlightRecorder::CLASSNAME("FlightRecorder");
+const char* FlightRecorder::MAGIC = "APTFLTRC";
+const quint32 FlightRecorder::VERSION = 1;
+const char* FlightRecorder::DEFAULTPATH = "flightrecorder.bin";
+const char* FlightRecorder::PREVIOUSSUFFIX = ".prev";
+const int FlightRecorder::DEFAULTCAPACITY = 65536;
+FlightRecorder FlightRecorder::instancePtr;
+
+FlightRecorder::FlightRecorder()
+{
+    _records = NULL;
+    _labels = NULL;
+    _mask = 0;
+    _clock.start();
+}
+
+FlightRecorder* FlightRecorder::instance() {
+    return &instancePtr;
+}
+
+bool FlightRecorder::initialize(const QString& path, int capacity) {
+    assert(!_records);
+    assert(capacity > 0);
+
+    // Masking beats a modulo on every event
+    quint32 roundedCapacity = 1;
+    while (roundedCapacity < quint32(capacity))
+        roundedCapacity <<= 1;
+
+    // Keep the previous run around; it may hold the events leading up to a crash
+    if (QFile::exists(path)) {
+        QFile::remove(path + PREVIOUSSUFFIX);
+        QFile::rename(path, path + PREVIOUSSUFFIX);
+    }
+
+    _file.setFileName(path);
+    qint64 size = sizeof(Header) + LABELCOUNT*LABELSIZE + qint64(roundedCapacity)*sizeof(Record);
+    if (!_file.open(QIODevice::ReadWrite | QIODevice::Truncate) || !_file.resize(size)) {
+        LOG_WARNING(CLASSNAME, NULL, LogMessage("Couldn't create %1, flight recorder disabled").arg(path));
+        _file.close();
+        return false;
+    }
+
+    uchar* base = _file.map(0, size);
+    if (!base) {
+        LOG_WARNING(CLASSNAME, NULL, LogMessage("Couldn't map %1, flight recorder disabled").arg(path));
+        _file.close();
+        return false;
+    }
+
+    // A freshly resized file is all zeroes, so every slot reads as unused
+    _clock.start();
+    Header* header = reinterpret_cast<Header*>(base);
+    memset(header, 0, sizeof(Header));
+    memcpy(header->magic, MAGIC, sizeof(header->magic));
+    header->version = VERSION;
+    header->recordSize = sizeof(Record);
+    header->capacity = roundedCapacity;
+    header->labelCount = LABELCOUNT;
+    header->labelSize = LABELSIZE;
+    header->startMsecs = QDateTime::currentMSecsSinceEpoch();
+    header->processId = QCoreApplication::applicationPid();
+
+    _mask = roundedCapacity - 1;
+    _next = 0;
+    _labels = reinterpret_cast<char*>(base + sizeof(Header));
+    _records = reinterpret_cast<Record*>(base + sizeof(Header) + LABELCOUNT*LABELSIZE);
+    record(Started, NULL, int(roundedCapacity));
+    return true;
+}
+
+void FlightRecorder::shutdown() {
+    if (!_records)
+        return;
+
+    record(Stopped);
+    uchar* base = reinterpret_cast<uchar*>(_labels) - sizeof(Header);
+    _records = NULL;
+    _labels = NULL;
+    _file.unmap(base);
+    _file.close();
+}
+
+void FlightRecorder::record(EventType type, const void* subject, qint32 a, qint32 b) {
+    Record* records = _records;
+    if (!records)
+        return;
+
+    quint32 sequence = quint32(_next.fetchAndAddRelaxed(1)) + 1;
+    Record& rec = records[(sequence - 1) & _mask];
+
+    // Clear the sequence first so a half-overwritten slot never looks complete
+    QAtomicInt* published = reinterpret_cast<QAtomicInt*>(&rec.sequence);
+    published->fetchAndStoreRelaxed(0);
+
+    quint64 threadId = quint64(quintptr(QThread::currentThreadId()));
+    rec.type = quint16(type);
+    rec.thread = quint16(threadId ^ (threadId >> 16) ^ (threadId >> 32) ^ (threadId >> 48));
+    rec.timestamp = now();
+    rec.subject = quint64(quintptr(subject));
+    rec.a = a;
+    rec.b = b;
+    published->fetchAndStoreRelease(int(sequence));
+}
+
+void FlightRecorder::setLabel(int index, const char* text) {
+    char* labels = _labels;
+    if (!labels || index < 0 || index >= LABELCOUNT)
+        return;
+
+    // Concurrent writers store the same text, so a race is harmless
+    char* label = labels + index*LABELSIZE;
+    if (!label[0])
+        qstrncpy(label, text, LABELSIZE);
+}
+
+const char* FlightRecorder::typeName(int type) {
+    static const char* names[EventTypeCount] = {
+        "?", "Started", "RefreshStarted", "RefreshFinished", "ParseFinished", "LockWaited",
+        "TimerFired", "ToastQueued", "FatalSignal", "Stopped"
+    };
+
+    if (type <= 0 || type >= EventTypeCount)
+        return names[0];
+    return names[type];
+}
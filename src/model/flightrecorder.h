@@ -0,0 +1,113 @@
+#ifndef FLIGHTRECORDER_H
+#define FLIGHTRECORDER_H
+
+#include "logger.h"
+#include <QFile>
+#include <QString>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+/**
+  * Always-on recorder of compact binary events, for finding out what happened
+  * right before a crash. Events go into a fixed-size ring that lives in a
+  * memory-mapped file: whatever was recorded is in the page cache, and ends up
+  * on disk even if the process dies. Recording an event is an atomic increment,
+  * a clock read and a few stores. Use the flightdecoder tool to read the file.
+  *
+  * The file of the previous run is kept as PREVIOUSSUFFIX, so it can still be
+  * decoded after the application was restarted.
+  * \author Pieter De Decker
+  */
+class FlightRecorder
+{
+private:
+    FlightRecorder();
+public:
+    static FlightRecorder* instance();
+
+    /** EVENT TYPES
+      *
+      * Each event has a subject (usually the address of the calendar involved) and
+      * two integer values whose meaning depends on the type.
+      *
+      * Started           a: ring capacity
+      * RefreshStarted    a: 1 if manual
+      * RefreshFinished   a: calendar status code, b: milliseconds since RefreshStarted
+      * ParseFinished     a: appointments read (-1 if unchanged or invalid), b: parse time in us
+      * LockWaited        a: wait time in us, b: label of the lock site
+      * TimerFired        a: TimerKind
+      * ToastQueued       a: number of appointments
+      * FatalSignal       a: signal number
+      * Stopped
+      */
+    enum EventType { Started = 1, RefreshStarted, RefreshFinished, ParseFinished, LockWaited,
+                     TimerFired, ToastQueued, FatalSignal, Stopped, EventTypeCount };
+
+    enum TimerKind { RefreshTimer, NotificationTimer };
+
+    /** Layout of the file header. All fields are in native byte order. The header
+      * is followed by 'labelCount' labels of 'labelSize' bytes, then by the ring. */
+    struct Header {
+        char magic[8];
+        quint32 version;
+        quint32 recordSize;
+        quint32 capacity;
+        quint32 labelCount;
+        qint64 startMsecs;      // Wall clock at initialize(), in ms since the epoch
+        qint64 processId;
+        quint32 labelSize;
+        char padding[20];
+    };
+
+    /** Layout of a single event. 'sequence' is written last: a slot is complete
+      * when it's non-zero, and the highest sequence is the latest event. */
+    struct Record {
+        quint32 sequence;
+        quint16 type;
+        quint16 thread;
+        qint64 timestamp;       // Microseconds since startMsecs
+        quint64 subject;
+        qint32 a;
+        qint32 b;
+    };
+
+    /** Creates and maps the ring file. Recording is a no-op until this succeeds.
+      * 'capacity' is rounded up to a power of two. */
+    bool initialize(const QString& path = DEFAULTPATH, int capacity = DEFAULTCAPACITY);
+
+    /** Records a Stopped event and unmaps the file. */
+    void shutdown();
+
+    /** [THREAD-SAFE] Appends an event to the ring, overwriting the oldest one. */
+    void record(EventType type, const void* subject = 0, qint32 a = 0, qint32 b = 0);
+
+    /** [THREAD-SAFE] Stores a name for a small integer that events refer to, such as
+      * a lock site. The first name stored for an index sticks. */
+    void setLabel(int index, const char* text);
+
+    /** [THREAD-SAFE] Microseconds since initialize(), on the recorder's monotonic clock. */
+    qint64 now() const { return _clock.nsecsElapsed()/1000; }
+
+    /** Human-readable name of an event type, for the decoder. */
+    static const char* typeName(int type);
+
+    static const char* MAGIC;
+    static const quint32 VERSION;
+    static const char* DEFAULTPATH;
+    static const char* PREVIOUSSUFFIX;
+    static const int DEFAULTCAPACITY;
+
+    enum { LABELCOUNT = 128, LABELSIZE = 48 };
+private:
+    static LogCategory CLASSNAME;
+    static FlightRecorder instancePtr;
+
+    QFile _file;
+    QElapsedTimer _clock;
+    Record* _records;
+    char* _labels;
+    quint32 _mask;
+    QAtomicInt _next;
+};
+
+#endif // FLIGHTRECORDER_H
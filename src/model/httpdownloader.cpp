@@ -1,26 +1,66 @@
 #include "httpdownloader.h"
 
 #include "logger.h"
+#include "metrics.h"
+#include "bodycache.h"
 #include <QUrl>
+#include <QLocale>
 #include <cassert>
+#include <algorithm>
+#include <QStringList>
 #include <QNetworkRequest>
 
-const char* HttpDownloader::CLASSNAME = "HttpDownloader";
+LogCategory HttpDownloader::CLASSNAME("HttpDownloader");
+
+namespace {
+    const int durationBounds[] = { 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000 };
+
+    Counter requestsMetric("aptnotifier_http_requests_total", "HTTP requests sent");
+    Counter failuresMetric("aptnotifier_http_failures_total", "HTTP requests that didn't produce a calendar");
+    Counter notModifiedMetric("aptnotifier_http_not_modified_total", "Responses answered from the body cache after a 304");
+    Counter bytesMetric("aptnotifier_http_received_bytes_total", "Response bytes received, not counting bodies reused after a 304");
+    Histogram durationMetric("aptnotifier_http_request_duration_milliseconds", "Time from sending a request to its response",
+                             durationBounds, sizeof(durationBounds)/sizeof(durationBounds[0]));
+}
 
 HttpDownloader::HttpDownloader(QObject *parent) :
     QObject(parent)
 {
+    _lastFreshnessLifetime = -1;
+    _lastCacheable = false;
 }
 
-void HttpDownloader::doGet(const QString& url) {
+HttpDownloader::~HttpDownloader()
+{
+    FetchScheduler::instance()->cancel(this);
+}
+
+void HttpDownloader::doGet(const QString& url, FetchScheduler::Priority priority) {
     QByteArray urlArray;
     QUrl urlObj = QUrl::fromEncoded(urlArray.append(url));
-    doGet(urlObj);
+    doGet(urlObj, priority);
 }
 
-void HttpDownloader::doGet(const QUrl &url) {
-    Logger::instance()->add(CLASSNAME, this, "Filed GET request for " + url.toString());
+void HttpDownloader::doGet(const QUrl &url, FetchScheduler::Priority priority) {
+    LOG_DEBUG(CLASSNAME, this, LogMessage("Queued GET request for %1").arg(url));
+    FetchScheduler::instance()->enqueue(this, url, priority);
+}
+
+void HttpDownloader::startGet(const QUrl &url) {
+    LOG_DEBUG(CLASSNAME, this, LogMessage("Filed GET request for %1").arg(url));
     QNetworkRequest request(url);
+
+    // Make the request conditional if we have a cached copy
+    QByteArray etag, lastModified;
+    if (BodyCache::instance()->validators(url, etag, lastModified)) {
+        if (!etag.isEmpty())
+            request.setRawHeader("If-None-Match", etag);
+        if (!lastModified.isEmpty())
+            request.setRawHeader("If-Modified-Since", lastModified);
+    }
+
+    requestsMetric.add();
+    _requestTimer.start();
     QNetworkAccessManager *manager = new QNetworkAccessManager(this);
     QNetworkReply *reply = manager->get(request);
     doConnects(reply, manager);
@@ -28,8 +68,10 @@ void HttpDownloader::doGet(const QUrl &url) {
 
 void HttpDownloader::doPost(const QString& url, QByteArray *message) {
     assert(message);
-    Logger::instance()->add(CLASSNAME, this, "Filed POST request for " + url);
+    LOG_DEBUG(CLASSNAME, this, LogMessage("Filed POST request for %1").arg(url));
     QNetworkRequest request(url);
+    requestsMetric.add();
+    _requestTimer.start();
     QNetworkAccessManager *manager = new QNetworkAccessManager(this);
     QNetworkReply *reply = manager->post(request, *message);
     doConnects(reply, manager);
@@ -58,40 +100,108 @@ void HttpDownloader::doConnects(QNetworkReply *reply, QNetworkAccessManager* man
 void HttpDownloader::requestReturned(QNetworkReply* rep) {
     assert(rep);
     QVariant status = rep->attribute(QNetworkRequest::HttpStatusCodeAttribute);
-
-    if (status != 200 || status == NULL) {
-        Logger::instance()->add(CLASSNAME, this, "Received non-200 response");
-        QString *lastError = new QString("HTTP ERROR " + rep->attribute(QNetworkRequest::HttpStatusCodeAttribute).toString()
-                                         + " (" + rep->errorString() + ")\r\n---\r\n\r\n " + rep->readAll());
-
+    QUrl url = rep->request().url();
+    QByteArray cachedBody;
+    durationMetric.observe(int(_requestTimer.elapsed()));
+    _lastCacheable = false;
+    _lastETag.clear();
+    _lastModified.clear();
+
+    if (status.toInt() == 304 && BodyCache::instance()->lookup(url, cachedBody)) {
+        LOG_DEBUG(CLASSNAME, this, "Resource not modified, using cached copy");
+        notModifiedMetric.add();
+        _lastFreshnessLifetime = freshnessLifetime(rep);
+        emit receivedData(true, cachedBody);
+    } else if (status != 200 || status == NULL) {
+        LOG_WARNING(CLASSNAME, this, LogMessage("Received HTTP %1 for %2").arg(status).arg(url));
+        failuresMetric.add();
+        QByteArray lastError = "HTTP ERROR " + rep->attribute(QNetworkRequest::HttpStatusCodeAttribute).toByteArray()
+                + " (" + rep->errorString().toUtf8() + ")\r\n---\r\n\r\n " + rep->readAll();
+
+        _lastFreshnessLifetime = -1;
         emit receivedData(false, lastError);
-        delete lastError;
     } else {
-        Logger::instance()->add(CLASSNAME, this, "Received response");
-        QString *retString = new QString(rep->readAll());
-        *retString = retString->trimmed();
-        emit receivedData(true, retString);
-        delete retString;
+        LOG_DEBUG(CLASSNAME, this, "Received response");
+        _lastFreshnessLifetime = freshnessLifetime(rep);
+        QByteArray body = rep->readAll();
+        bytesMetric.add(body.size());
+        // The receiver stores the body once it has checked that it is a calendar
+        _lastCacheable = true;
+        _lastETag = rep->rawHeader("ETag");
+        _lastModified = rep->rawHeader("Last-Modified");
+        emit receivedData(true, body);
     }
 
     rep->manager()->deleteResource(rep->request());
     rep->manager()->deleteLater();
     rep->deleteLater();
     sender()->deleteLater();
+
+    // Let the next queued request take our slot
+    FetchScheduler::instance()->finished(this);
+}
+
+int HttpDownloader::freshnessLifetime(QNetworkReply* reply) {
+    assert(reply);
+
+    // Cache-Control takes precedence over Expires (RFC 2616, section 14.9.3)
+    if (reply->hasRawHeader("Cache-Control")) {
+        QStringList directives = QString(reply->rawHeader("Cache-Control")).split(",");
+        foreach (QString directive, directives) {
+            directive = directive.trimmed().toLower();
+
+            // The server doesn't want us to reuse the response at all
+            if (directive == "no-cache" || directive == "no-store")
+                return 0;
+
+            if (directive.startsWith("max-age=")) {
+                bool ok;
+                int maxAge = directive.mid(8).toInt(&ok);
+                if (ok && maxAge >= 0)
+                    return maxAge;
+            }
+        }
+    }
+
+    // Fall back on the Expires header, relative to the server's clock if it sent one
+    if (reply->hasRawHeader("Expires")) {
+        QDateTime expires = parseHttpDate(reply->rawHeader("Expires"));
+        QDateTime date = parseHttpDate(reply->rawHeader("Date"));
+        if (!date.isValid())
+            date = QDateTime::currentDateTimeUtc();
+
+        // Per RFC 2616, an invalid Expires value means "already expired"
+        if (!expires.isValid())
+            return 0;
+        return std::max(0, date.secsTo(expires));
+    }
+
+    return -1;
+}
+
+QDateTime HttpDownloader::parseHttpDate(const QByteArray& value) {
+    QString dateStr = QString(value).trimmed();
+    if (dateStr.isEmpty())
+        return QDateTime();
+
+    // Example: "Sun, 06 Nov 1994 08:49:37 GMT"
+    QDateTime result = QLocale::c().toDateTime(dateStr.left(25), "ddd, dd MMM yyyy hh:mm:ss");
+    result.setTimeSpec(Qt::UTC);
+    return result;
 }
 
 void HttpDownloader::proxyAuthFail(const QNetworkProxy&, QAuthenticator*) {
-    Logger::instance()->add(CLASSNAME, this, "Proxy authentication failed");
+    LOG_WARNING(CLASSNAME, this, "Proxy authentication failed");
 }
 
 void HttpDownloader::sslErrorFail(QNetworkReply*, const QList<QSslError>&) {
-    Logger::instance()->add(CLASSNAME, this, "SSL error in QNetworkManager");
+    LOG_WARNING(CLASSNAME, this, "SSL error in QNetworkManager");
 }
 
 void HttpDownloader::reqError(QNetworkReply::NetworkError code) {
-    Logger::instance()->add(CLASSNAME, this, "Request QNetworkReply::NetworkError code " + QString::number(code));
+    LOG_WARNING(CLASSNAME, this, LogMessage("Request QNetworkReply::NetworkError code %1").arg(int(code)));
 }
 
 void HttpDownloader::sslError(const QList<QSslError>&) {
-    Logger::instance()->add(CLASSNAME, this, "SSL error in QNetworkReply");
+    LOG_WARNING(CLASSNAME, this, "SSL error in QNetworkReply");
 }
@@ -1,7 +1,11 @@
 #ifndef HTTPDOWNLOADER_H
 #define HTTPDOWNLOADER_H
 
+#include "logger.h"
+#include "fetchscheduler.h"
 #include <QObject>
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <QNetworkReply>
 #include <QNetworkAccessManager>
 
@@ -16,18 +20,54 @@ class HttpDownloader : public QObject
     Q_OBJECT
 public:
     HttpDownloader(QObject *parent = 0);
+    ~HttpDownloader();
 
     // Functions
-    void doGet(const QString& url);
-    void doGet(const QUrl& url);
+    /** GET requests are queued in the FetchScheduler, which decides when they start. */
+    void doGet(const QString& url, FetchScheduler::Priority priority = FetchScheduler::Background);
+    void doGet(const QUrl& url, FetchScheduler::Priority priority = FetchScheduler::Background);
     void doPost(const QString& url, QByteArray* message);
     void doPut(QString, QString);
     void doConnects(QNetworkReply* reply, QNetworkAccessManager* manager);
+
+    /** Freshness lifetime (in seconds) the server announced for the last response
+      * through its Cache-Control or Expires header. Returns -1 if the server gave
+      * no hint. Only meaningful while receivedData is being handled. */
+    int lastFreshnessLifetime() const { return _lastFreshnessLifetime; }
+
+    /** Whether the last response was a full 200 body that may be cached once it
+      * proves to be valid. Only meaningful while receivedData is being handled. */
+    bool lastResponseCacheable() const { return _lastCacheable; }
+
+    /** Validators the server sent along with the last cacheable response. */
+    QByteArray lastETag() const { return _lastETag; }
+    QByteArray lastModified() const { return _lastModified; }
 signals:
-    void receivedData(bool success, QString* data);
+    /** Delivers the response body as raw bytes. On failure, 'data' holds a
+      * description of the error instead. The array is implicitly shared, so
+      * receivers can keep a reference without copying the body. */
+    void receivedData(bool success, const QByteArray& data);
 private:
-    static const char* CLASSNAME;
+    static LogCategory CLASSNAME;
+
+    /** Extracts the freshness lifetime from the Cache-Control and Expires headers
+      * of a reply. Returns -1 if neither header yields a usable lifetime. */
+    static int freshnessLifetime(QNetworkReply* reply);
+
+    /** Parses an RFC 1123 HTTP date. Returns an invalid QDateTime on failure. */
+    static QDateTime parseHttpDate(const QByteArray& value);
+
+    int _lastFreshnessLifetime;
+    bool _lastCacheable;
+    QByteArray _lastETag;
+    QByteArray _lastModified;
+
+    /** Started when the current request was sent, for the duration metric. */
+    QElapsedTimer _requestTimer;
 private slots:
+    /** Invoked by the FetchScheduler once a slot is available for our GET request. */
+    void startGet(const QUrl& url);
+
     // Success slots
     void requestReturned(QNetworkReply* reply);
 
@@ -1,60 +1,95 @@
 #include "icsparser.h"
 
+#include "utf8.h"
+#include "metrics.h"
 #include "aptcache.h"
+#include "appointment.h"
+#include "filterrules.h"
+#include <cctype>
 #include <cassert>
+#include <cstring>
 #include <QRegExp>
+#include <QElapsedTimer>
 
-ICSParser::ICSParser(const QString& rawICS) {
-    // Store the data
-    _rawData = rawICS;
-    _rawData.replace("\r", "");
+namespace {
+    const int durationBounds[] = { 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000 };
 
-    // Calculate the calendar checksum based on Last Modified attributes
-    QString checksumData = _rawData;
-    checksumData.replace(QRegExp("((^|\\n)(?!LAST-MODIFIED)[^\\n]*)+"), "");
-    _checksum = qChecksum(checksumData.toUtf8(), checksumData.length());
+    Counter bytesMetric("aptnotifier_ics_parsed_bytes_total", "Calendar data handed to the ICS parser");
+    Counter eventsMetric("aptnotifier_ics_parsed_events_total", "Events read from calendar files, including ones that already ended");
+    Histogram scanMetric("aptnotifier_ics_scan_duration_microseconds", "Time to checksum a calendar file and read its properties",
+                         durationBounds, sizeof(durationBounds)/sizeof(durationBounds[0]));
+    Histogram readMetric("aptnotifier_ics_read_duration_microseconds", "Time to read all events of a calendar file into a cache",
+                         durationBounds, sizeof(durationBounds)/sizeof(durationBounds[0]));
+}
 
-    // If we can't checksum because Last Modified attributes are unavailable,
-    // fall back on regular file checksumming.
-    if (_checksum == 0)
-        _checksum = qChecksum(_rawData.toUtf8(), _rawData.length());
+ICSParser::ICSParser(const QByteArray& rawICS)
+    : _rawData(rawICS)
+{
+    QElapsedTimer timer;
+    timer.start();
+    bytesMetric.add(_rawData.size());
+
+    // Calculate the calendar checksum based on Last Modified attributes
+    _checksum = calcChecksum();
 
     // Check if we can extract the calendar name
     int calNamePos = _rawData.indexOf("X-WR-CALNAME:");
-    if (calNamePos != -1) {
-        _name = _rawData.mid(calNamePos + 13);
-        _name = _name.left(_name.indexOf("\n"));
-    }
+    if (calNamePos != -1)
+        _name = Utf8::decode(Appointment::lineAt(_rawData, calNamePos + 13));
+
+    // Check if the publisher suggests a refresh interval. REFRESH-INTERVAL
+    // (RFC 7986) supersedes the older X-PUBLISHED-TTL extension.
+    _refreshInterval = parseDuration(calendarProperty("REFRESH-INTERVAL"));
+    if (_refreshInterval == -1)
+        _refreshInterval = parseDuration(calendarProperty("X-PUBLISHED-TTL"));
+
+    scanMetric.observe(int(timer.nsecsElapsed()/1000));
 }
 
 bool ICSParser::holdsValidICS() const {
+    // Servers sometimes pad the file with whitespace
+    const char* data = _rawData.constData();
+    int start = 0;
+    while (start < _rawData.size() && isspace((unsigned char)data[start]))
+        ++start;
+
     // If we don't have the ICS header, this is not a valid calendar
-    if (_rawData.indexOf("BEGIN:VCALENDAR") != 0) {
+    if (_rawData.size() - start < 15 || strncmp(data + start, "BEGIN:VCALENDAR", 15) != 0) {
         return false;
     }
 
     return true;
 }
 
-AptCache* ICSParser::readAppointments() const {
+AptCache* ICSParser::readAppointments(const FilterRules* rules, int calendarId) const {
+    QElapsedTimer timer;
+    timer.start();
     QDateTime now = QDateTime::currentDateTime();
-    QString rawData = _rawData;
     AptCache* aptCache = new AptCache();
+    int eventCount = 0;
 
     // Loop until all events are cached
-    while (eventsLeft(rawData)) {
-        QString calInfo = getRawApt(rawData);
+    int beginPos = _rawData.indexOf("BEGIN:VEVENT");
+    while (beginPos != -1) {
+        int endPos = _rawData.indexOf("END:VEVENT", beginPos);
+        if (endPos == -1)
+            break;
+
+        // Look at the event in place instead of copying it
+        QByteArray calInfo = QByteArray::fromRawData(_rawData.constData() + beginPos, endPos - beginPos);
         Appointment newApt(calInfo);
+        ++eventCount;
 
         // Add the newly extracted appointment if it hasn't already ended
         if (newApt.isValid() && now < newApt.end()) {
+            if (rules)
+                newApt.setPriority(rules->classify(calendarId, newApt));
             aptCache->appointments()->insert(newApt.start(), newApt);
 
             // Create reminders where needed
-            int triggerPos = calInfo.indexOf("TRIGGER:-P");
+            int triggerPos = (newApt.priority() == Appointment::Muted) ? -1 : calInfo.indexOf("TRIGGER:-P");
             while (triggerPos != -1) {
-                QString triggerInfo = calInfo.mid(triggerPos + 10);
-                triggerInfo = triggerInfo.left(triggerInfo.indexOf("\n"));
+                QString triggerInfo = QString::fromLatin1(Appointment::lineAt(calInfo, triggerPos + 10));
 
                 // Only add reminder times that haven't passed yet
                 QDateTime reminderStamp = constructReminderTime(newApt.start(), triggerInfo);
@@ -62,18 +97,93 @@ AptCache* ICSParser::readAppointments() const {
                 if (now <= reminderStamp)
                     aptCache->reminders()->insert(reminderStamp, newApt);
 
-                calInfo = calInfo.mid(triggerPos + 10);
-                triggerPos = calInfo.indexOf("TRIGGER:-P");
+                triggerPos = calInfo.indexOf("TRIGGER:-P", triggerPos + 10);
             }
         }
 
         // Prepare for next appointment
-        rawData = rawData.mid(rawData.indexOf("END:VEVENT") + 10);
+        beginPos = _rawData.indexOf("BEGIN:VEVENT", endPos + 10);
     }
 
+    aptCache->updateMetrics();
+    eventsMetric.add(eventCount);
+    readMetric.observe(int(timer.nsecsElapsed()/1000));
     return aptCache;
 }
 
+int ICSParser::parseDuration(const QString& duration) {
+    QRegExp format("^P(?:(\\d+)W)?(?:(\\d+)D)?(?:T(?:(\\d+)H)?(?:(\\d+)M)?(?:(\\d+)S)?)?$");
+    if (duration.isEmpty() || !format.exactMatch(duration.trimmed()))
+        return -1;
+
+    int seconds = format.cap(1).toInt()*7*24*60*60
+            + format.cap(2).toInt()*24*60*60
+            + format.cap(3).toInt()*60*60
+            + format.cap(4).toInt()*60
+            + format.cap(5).toInt();
+
+    // "P" and "PT" on their own aren't meaningful durations
+    return seconds > 0 ? seconds : -1;
+}
+
+int ICSParser::calcChecksum() const {
+    // 32-bit FNV-1a, which can be fed line by line without building
+    // a separate string first
+    const quint32 fnvPrime = 16777619u;
+    quint32 hash = 2166136261u;
+    const char* data = _rawData.constData();
+
+    bool foundModified = false;
+    int pos = findLine("LAST-MODIFIED", 0);
+    while (pos != -1) {
+        foundModified = true;
+        for (; pos < _rawData.size() && data[pos] != '\n'; ++pos) {
+            if (data[pos] != '\r')
+                hash = (hash ^ (unsigned char)data[pos]) * fnvPrime;
+        }
+        hash = (hash ^ '\n') * fnvPrime;
+        pos = findLine("LAST-MODIFIED", pos);
+    }
+
+    // If we can't checksum because Last Modified attributes are unavailable,
+    // fall back on regular file checksumming.
+    if (!foundModified) {
+        for (int i = 0; i < _rawData.size(); ++i) {
+            if (data[i] != '\r')
+                hash = (hash ^ (unsigned char)data[i]) * fnvPrime;
+        }
+    }
+
+    return (int)hash;
+}
+
+int ICSParser::findLine(const char* property, int from) const {
+    int length = (int)strlen(property);
+    int pos = _rawData.indexOf(property, from);
+    while (pos != -1) {
+        if (pos == 0 || _rawData.at(pos - 1) == '\n')
+            return pos + length;
+        pos = _rawData.indexOf(property, pos + length);
+    }
+
+    return -1;
+}
+
+QByteArray ICSParser::calendarProperty(const char* property) const {
+    // Calendar-level properties precede the first component
+    int firstComponent = _rawData.indexOf("BEGIN:VEVENT");
+    int propertyPos = findLine(property, 0);
+    while (propertyPos != -1 && propertyPos < _rawData.size()
+           && _rawData.at(propertyPos) != ':' && _rawData.at(propertyPos) != ';')
+        propertyPos = findLine(property, propertyPos);
+    if (propertyPos == -1 || propertyPos >= _rawData.size()
+            || (firstComponent != -1 && firstComponent < propertyPos))
+        return QByteArray();
+
+    QByteArray value = Appointment::lineAt(_rawData, propertyPos);
+    return value.mid(value.lastIndexOf(':') + 1);
+}
+
 QDateTime ICSParser::constructReminderTime(const QDateTime& aptStart, const QString& triggerInfo) const {
     QDateTime reminderStamp = aptStart;
     QString triggerTmp = triggerInfo;
@@ -98,29 +208,3 @@ QDateTime ICSParser::constructReminderTime(const QDateTime& aptStart, const QStr
 
     return reminderStamp;
 }
-
-bool ICSParser::eventsLeft(const QString& rawData) const {
-    int beginPos = rawData.indexOf("BEGIN:VEVENT");
-    int endPos = rawData.indexOf("END:VEVENT");
-
-    if (beginPos == -1 || endPos == -1 || beginPos > endPos)
-        return false;
-    else
-        return true;
-}
-
-QString ICSParser::getRawApt(const QString& rawData) const {
-    int beginPos = rawData.indexOf("BEGIN:VEVENT");
-    int endPos = rawData.indexOf("END:VEVENT");
-    QString calInfo = rawData.mid(beginPos, endPos - beginPos);
-
-    return calInfo;
-}
-
-QString ICSParser::trimCurrentApt(QString& rawData) const {
-    int endPos = rawData.indexOf("END:VEVENT");
-    assert(endPos != -1);
-    rawData = rawData.mid(endPos + 10);
-    return rawData;
-}
-
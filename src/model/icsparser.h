@@ -3,26 +3,30 @@
 
 #include <QString>
 #include <QDateTime>
+#include <QByteArray>
 
 class AptCache;
+class FilterRules;
 
 /**
-  * Parses an ICS calendar file, which is supplied as a string in
-  * the object constructor.
+  * Parses an ICS calendar file, which is supplied as UTF-8 data in the
+  * object constructor. The data is shared with the caller, not copied.
   * \author Pieter De Decker
   */
 class ICSParser
 {
 public:
-    ICSParser(const QString& rawICS);
+    ICSParser(const QByteArray& rawICS);
 
     /** Does an elementary validity check on an alleged ICS file. */
     bool holdsValidICS() const;
 
     /** Allocates an AptCache structure filled with all events found
       * in the ICS file. Ownership of the AptCache structure is
-      * transferred to the caller. */
-    AptCache* readAppointments() const;
+      * transferred to the caller. If 'rules' is given, every event gets
+      * the priority they assign for calendar 'calendarId', and muted events
+      * don't get reminders. */
+    AptCache* readAppointments(const FilterRules* rules = NULL, int calendarId = -1) const;
 
     /** Getter for the calendar checksum that is used to detect
       * changes that occured between two calendar downloads. */
@@ -32,24 +36,36 @@ public:
       * property. */
     QString name() const { return _name; }
 
+    /** Getter for the refresh interval (in seconds) the publisher suggests through
+      * the X-PUBLISHED-TTL or REFRESH-INTERVAL property. Returns -1 if neither
+      * property is present. */
+    int refreshInterval() const { return _refreshInterval; }
+
+    /** Converts an ISO 8601 duration such as "PT1H" or "P1W" to seconds. Returns
+      * -1 if the string isn't a valid duration. */
+    static int parseDuration(const QString& duration);
+
 private:
     /** Determines the reminder timestamp of an appointment based on the appointment
       * time and the "TRIGGER" field. */
     QDateTime constructReminderTime(const QDateTime& aptStart, const QString& triggerInfo) const;
 
-    /** Gets the raw data inside the next appointment. */
-    QString getRawApt(const QString& rawData) const;
+    /** Calculates the checksum over all LAST-MODIFIED lines, or over the whole
+      * file if there are none. Carriage returns are skipped. */
+    int calcChecksum() const;
 
-    /** Trims the frontmost appointment from _rawData. */
-    QString trimCurrentApt(QString& rawData) const;
+    /** Returns the position right after 'property' if it starts a line, searching
+      * from 'from'. Returns -1 if there is no such line. */
+    int findLine(const char* property, int from) const;
 
-    /** If there are any events left in the ICS file, this function
-      * returns true. */
-    bool eventsLeft(const QString& rawData) const;
+    /** Looks up the value of a calendar-level property. Parameters between the
+      * property name and the colon (e.g. ";VALUE=DURATION") are skipped. */
+    QByteArray calendarProperty(const char* property) const;
 
-    QString _rawData;
+    QByteArray _rawData;
     int _checksum;
     QString _name;
+    int _refreshInterval;
 };
 
 #endif // ICSPARSER_H
@@ -0,0 +1,87 @@
+#include "localfilesource.h"
+
+#include "logger.h"
+#include <QFile>
+#include <QFileInfo>
+
+LogCategory LocalFileSource::CLASSNAME("LocalFileSource");
+const int LocalFileSource::SETTLEMSECS = 100;
+
+LocalFileSource::LocalFileSource(const QString& path, QObject* parent)
+    : QObject(parent), _path(path), _watcher(this), _settleTimer(this)
+{
+    // Watch the directory as well, so atomic replacements (which remove the
+    // watched inode) and files that don't exist yet are noticed too
+    _watcher.addPath(QFileInfo(_path).absolutePath());
+    if (QFile::exists(_path))
+        _watcher.addPath(_path);
+    connect(&_watcher, SIGNAL(fileChanged(QString)), this, SLOT(fileChanged()));
+    connect(&_watcher, SIGNAL(directoryChanged(QString)), this, SLOT(directoryChanged()));
+
+    connect(&_settleTimer, SIGNAL(timeout()), this, SLOT(settled()));
+    _settleTimer.setSingleShot(true);
+    _settleTimer.setInterval(SETTLEMSECS);
+}
+
+void LocalFileSource::read()
+{
+    LOG_DEBUG(CLASSNAME, this, LogMessage("Reading %1").arg(_path));
+    _lastFingerprint = fingerprint();
+
+    // The parse gets a copy of its own, so writers can't pull the data from
+    // under it
+    QFile file(_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        emit receivedData(false, "Couldn't open " + _path.toUtf8() + ": " + file.errorString().toUtf8());
+        return;
+    }
+
+    QByteArray data = file.readAll();
+    if (file.error() != QFile::NoError) {
+        emit receivedData(false, "Couldn't read " + _path.toUtf8() + ": " + file.errorString().toUtf8());
+        return;
+    }
+
+    emit receivedData(true, data);
+}
+
+void LocalFileSource::fileChanged()
+{
+    // The watch on the file is lost when it's replaced, so renew it
+    if (QFile::exists(_path) && !_watcher.files().contains(_path))
+        _watcher.addPath(_path);
+
+    _settleTimer.start();
+}
+
+void LocalFileSource::directoryChanged()
+{
+    if (fingerprint() != _lastFingerprint)
+        fileChanged();
+}
+
+void LocalFileSource::settled()
+{
+    // A writer that is still busy keeps moving the size or timestamp
+    QString current = fingerprint();
+    if (current != _settleFingerprint) {
+        _settleFingerprint = current;
+        _settleTimer.start();
+        return;
+    }
+
+    LOG_DEBUG(CLASSNAME, this, LogMessage("Detected change in %1").arg(_path));
+    emit changed();
+}
+
+QString LocalFileSource::fingerprint() const
+{
+    QFileInfo info(_path);
+    if (!info.exists())
+        return QString();
+
+    // On Unix, created() reports the status change time, which also moves
+    // when the file is replaced through a rename
+    return QString::number(info.size()) + "/" + info.lastModified().toString(Qt::ISODate)
+            + "/" + QString::number(info.created().toTime_t());
+}
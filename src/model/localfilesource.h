@@ -0,0 +1,67 @@
+#ifndef LOCALFILESOURCE_H
+#define LOCALFILESOURCE_H
+
+#include "logger.h"
+#include <QTimer>
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QFileSystemWatcher>
+
+/**
+  * Reads calendar files from the local file system for file:// calendars. Changes
+  * are picked up through QFileSystemWatcher, which uses inotify on Linux, so
+  * nothing is polled.
+  *
+  * Files are read into memory rather than mapped: other programs may rewrite them
+  * in place while the parse runs, and a mapping of a truncated file crashes the
+  * reader. Calendar files are small, so the copy costs little. Changes are only
+  * reported once the file's size and timestamp have stopped moving, so we don't
+  * read a file that is still being written.
+  *
+  * \author Pieter De Decker
+  */
+class LocalFileSource : public QObject
+{
+    Q_OBJECT
+public:
+    LocalFileSource(const QString& path, QObject* parent = 0);
+
+    /** Reads the file and emits receivedData. */
+    void read();
+signals:
+    /** Delivers the file contents, or a description of the error on failure. Same
+      * contract as HttpDownloader::receivedData. */
+    void receivedData(bool success, const QByteArray& data);
+
+    /** Broadcast shortly after the file has been modified, created or replaced. */
+    void changed();
+private slots:
+    /** Called by the watcher when the file changes. Restarts the settle timer,
+      * so a burst of writes only leads to one changed() signal. */
+    void fileChanged();
+
+    /** Called by the watcher when anything in the file's directory changes. Only
+      * counts as a change if our file was created, replaced or removed. */
+    void directoryChanged();
+
+    /** Called SETTLEMSECS after the last notification. Reports the change if the
+      * file's metadata didn't move since the previous check, or waits another
+      * SETTLEMSECS if it did. */
+    void settled();
+private:
+    static LogCategory CLASSNAME;
+    static const int SETTLEMSECS;
+
+    /** Returns a fingerprint of the file's metadata, used to ignore directory
+      * notifications about other files. */
+    QString fingerprint() const;
+
+    QString _path;
+    QString _lastFingerprint;
+    QString _settleFingerprint;
+    QFileSystemWatcher _watcher;
+    QTimer _settleTimer;
+};
+
+#endif // LOCALFILESOURCE_H
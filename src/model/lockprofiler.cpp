@@ -0,0 +1,182 @@
+#include "lockprofiler.h"
+
+#include <QMap>
+#include <cassert>
+#include <climits>
+#include <algorithm>
+#include <QStringList>
+
+LockProfiler LockProfiler::instancePtr;
+
+namespace {
+    /** Counters of all sites with the same name, merged for the report. */
+    struct Totals {
+        Totals() : acquisitions(0), contended(0), maxWaitUs(0), maxHoldUs(0) {
+            std::fill(waitBuckets, waitBuckets + LockProfiler::BUCKETCOUNT, 0);
+            std::fill(holdBuckets, holdBuckets + LockProfiler::BUCKETCOUNT, 0);
+        }
+
+        int acquisitions;
+        int contended;
+        int maxWaitUs;
+        int maxHoldUs;
+        int waitBuckets[LockProfiler::BUCKETCOUNT];
+        int holdBuckets[LockProfiler::BUCKETCOUNT];
+    };
+
+    /** Upper bound of a histogram bucket in microseconds. */
+    qint64 bucketLimit(int bucket) {
+        return qint64(1) << bucket;
+    }
+
+    /** Estimates a percentile as the upper bound of the bucket it falls in. */
+    qint64 percentile(const int* buckets, int count, int pct) {
+        if (count == 0)
+            return 0;
+
+        qint64 rank = (qint64(count)*pct + 99)/100;
+        qint64 seen = 0;
+        for (int i = 0; i < LockProfiler::BUCKETCOUNT; ++i) {
+            seen += buckets[i];
+            if (seen >= rank)
+                return bucketLimit(i);
+        }
+        return bucketLimit(LockProfiler::BUCKETCOUNT - 1);
+    }
+
+    /** Estimates the total time in a histogram, counting each entry at its bucket's midpoint. */
+    qint64 estimatedTotal(const int* buckets) {
+        qint64 total = 0;
+        for (int i = 1; i < LockProfiler::BUCKETCOUNT; ++i)
+            total += buckets[i]*(bucketLimit(i) + bucketLimit(i - 1))/2;
+        return total;
+    }
+}
+
+LockProfiler::LockProfiler()
+{
+    _clock.start();
+}
+
+LockProfiler* LockProfiler::instance() {
+    return &instancePtr;
+}
+
+LockProfiler::Site* LockProfiler::site(const char* name) {
+    assert(name);
+    int start = int((quintptr(name) >> 3) % MAXSITES);
+
+    // Open addressing on the literal's address; claiming a free slot is a single CAS
+    for (int i = 0; i < MAXSITES; ++i) {
+        Site& candidate = _sites[(start + i) % MAXSITES];
+        const char* key = candidate.name;
+        if (key == name)
+            return &candidate;
+        if (!key) {
+            if (candidate.name.testAndSetOrdered(0, name))
+                return &candidate;
+            if ((const char*)candidate.name == name)
+                return &candidate;
+        }
+    }
+
+    return &_overflow;
+}
+
+void LockProfiler::recordWait(Site* site, qint64 waitNsecs) {
+    assert(site);
+    int micros = int(std::min(waitNsecs/1000, qint64(INT_MAX)));
+    site->acquisitions.fetchAndAddRelaxed(1);
+    if (waitNsecs > 0) {
+        site->contended.fetchAndAddRelaxed(1);
+        updateMax(site->maxWaitUs, micros);
+    }
+    site->waitBuckets[bucketFor(micros)].fetchAndAddRelaxed(1);
+}
+
+void LockProfiler::recordHold(Site* site, qint64 holdNsecs) {
+    assert(site);
+    int micros = int(std::min(holdNsecs/1000, qint64(INT_MAX)));
+    updateMax(site->maxHoldUs, micros);
+    site->holdBuckets[bucketFor(micros)].fetchAndAddRelaxed(1);
+}
+
+QString LockProfiler::report() {
+    // Merge sites by name; the same literal may live at several addresses
+    QMap<QString, Totals> merged;
+    for (int i = 0; i <= MAXSITES; ++i) {
+        Site& site = (i < MAXSITES) ? _sites[i] : _overflow;
+        const char* name = site.name;
+        if (!name && i < MAXSITES)
+            continue;
+
+        Totals& totals = merged[name ? QString(name) : QString("(overflow)")];
+        totals.acquisitions += site.acquisitions;
+        totals.contended += site.contended;
+        totals.maxWaitUs = std::max(totals.maxWaitUs, int(site.maxWaitUs));
+        totals.maxHoldUs = std::max(totals.maxHoldUs, int(site.maxHoldUs));
+        for (int b = 0; b < BUCKETCOUNT; ++b) {
+            totals.waitBuckets[b] += site.waitBuckets[b];
+            totals.holdBuckets[b] += site.holdBuckets[b];
+        }
+    }
+
+    // Rank by estimated total wait time
+    QMultiMap<qint64, QString> ranked;
+    for (QMap<QString, Totals>::const_iterator it = merged.constBegin(); it != merged.constEnd(); ++it) {
+        if (it->acquisitions > 0)
+            ranked.insert(-estimatedTotal(it->waitBuckets), it.key());
+    }
+
+    QStringList lines;
+    lines << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9")
+             .arg("site", -40).arg("acquired", 9).arg("contended", 10)
+             .arg("wait_sum", 9).arg("wait_p99", 9).arg("wait_max", 9)
+             .arg("hold_p50", 9).arg("hold_p99", 9).arg("hold_max", 9);
+    for (QMultiMap<qint64, QString>::const_iterator it = ranked.constBegin(); it != ranked.constEnd(); ++it) {
+        const Totals& totals = merged[it.value()];
+        int held = 0;
+        for (int b = 0; b < BUCKETCOUNT; ++b)
+            held += totals.holdBuckets[b];
+
+        lines << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9")
+                 .arg(it.value().left(40), -40).arg(totals.acquisitions, 9).arg(totals.contended, 10)
+                 .arg(-it.key(), 9)
+                 .arg(percentile(totals.waitBuckets, totals.acquisitions, 99), 9)
+                 .arg(totals.maxWaitUs, 9)
+                 .arg(percentile(totals.holdBuckets, held, 50), 9)
+                 .arg(percentile(totals.holdBuckets, held, 99), 9)
+                 .arg(totals.maxHoldUs, 9);
+    }
+
+    return lines.join("\n");
+}
+
+void LockProfiler::reset() {
+    for (int i = 0; i <= MAXSITES; ++i) {
+        Site& site = (i < MAXSITES) ? _sites[i] : _overflow;
+        site.acquisitions = 0;
+        site.contended = 0;
+        site.maxWaitUs = 0;
+        site.maxHoldUs = 0;
+        for (int b = 0; b < BUCKETCOUNT; ++b) {
+            site.waitBuckets[b] = 0;
+            site.holdBuckets[b] = 0;
+        }
+    }
+}
+
+int LockProfiler::bucketFor(qint64 micros) {
+    int bucket = 0;
+    while (micros > 0 && bucket < BUCKETCOUNT - 1) {
+        micros >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+void LockProfiler::updateMax(QAtomicInt& max, int value) {
+    int current = max;
+    while (value > current && !max.testAndSetRelaxed(current, value))
+        current = max;
+}
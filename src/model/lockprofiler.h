@@ -0,0 +1,80 @@
+#ifndef LOCKPROFILER_H
+#define LOCKPROFILER_H
+
+#include <QString>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QAtomicPointer>
+
+/**
+  * Records how long threads wait for and hold locks, per lock site. A site is
+  * identified by the address of a string literal (the 'reason' passed to
+  * Calendar::engageBufferLock), so looking it up is a short probe in a fixed
+  * table. All counters are atomics: recording never takes a lock or logs.
+  *
+  * Times are kept in power-of-two microsecond histograms. report() merges sites
+  * with the same name and ranks them by estimated total wait time.
+  * \author Pieter De Decker
+  */
+class LockProfiler
+{
+private:
+    LockProfiler();
+public:
+    static LockProfiler* instance();
+
+    enum { BUCKETCOUNT = 24, MAXSITES = 128 };
+
+    /** Counters for a single lock site. */
+    struct Site {
+        Site() : name(0), acquisitions(0), contended(0), maxWaitUs(0), maxHoldUs(0) {}
+
+        QAtomicPointer<const char> name;
+        QAtomicInt acquisitions;
+        QAtomicInt contended;
+        QAtomicInt maxWaitUs;
+        QAtomicInt maxHoldUs;
+        QAtomicInt waitBuckets[BUCKETCOUNT];
+        QAtomicInt holdBuckets[BUCKETCOUNT];
+    };
+
+    /** [THREAD-SAFE] Returns the counters for a lock site, registering it on first
+      * use. 'name' must outlive the profiler; pass a string literal. */
+    Site* site(const char* name);
+
+    /** Position of a site in the table, or -1 for the overflow site. Stable for the
+      * lifetime of the process, so it can identify the site elsewhere. */
+    int indexOf(const Site* site) const { return (site == &_overflow) ? -1 : int(site - _sites); }
+
+    /** [THREAD-SAFE] Current time in nanoseconds on the profiler's monotonic clock. */
+    qint64 now() const { return _clock.nsecsElapsed(); }
+
+    /** [THREAD-SAFE] Records a lock acquisition. Uncontended acquisitions pass 0. */
+    void recordWait(Site* site, qint64 waitNsecs);
+
+    /** [THREAD-SAFE] Records how long a lock was held after being acquired at 'site'. */
+    void recordHold(Site* site, qint64 holdNsecs);
+
+    /** [THREAD-SAFE] Returns a table of all sites, most contended first. */
+    QString report();
+
+    /** [THREAD-SAFE] Clears all counters. Sites stay registered. */
+    void reset();
+private:
+    /** Maps a duration to its histogram bucket: bucket 0 is below 1 us, bucket i
+      * covers [2^(i-1), 2^i) us and the last bucket catches everything above. */
+    static int bucketFor(qint64 micros);
+
+    /** Stores 'value' in 'max' if it's larger, without locking. */
+    static void updateMax(QAtomicInt& max, int value);
+
+    static LockProfiler instancePtr;
+
+    QElapsedTimer _clock;
+    Site _sites[MAXSITES];
+
+    /** Catches sites that don't fit in the table. */
+    Site _overflow;
+};
+
+#endif // LOCKPROFILER_H
@@ -1,15 +1,78 @@
 #include "logger.h"
 
+#include "flightrecorder.h"
+#include <csignal>
 #include <cassert>
+#include <QUrl>
 #include <iostream>
+#include <QThread>
 #include <QDateTime>
+#include <QStringList>
 #include <QCoreApplication>
 
+/**
+  * Background thread that writes the Logger's ring buffer to disk.
+  */
+class LogWriter : public QThread
+{
+protected:
+    void run() { Logger::instance()->writerLoop(); }
+};
+
+const char* Logger::CLASSNAME = "Logger";
+const char* Logger::LEVELTAGS = "TDIWE";
+const int Logger::WRITEINTERVAL = 20;
+const int Logger::BATCHBYTES = 64*1024;
 Logger Logger::instancePtr;
+LogCategory* LogCategory::first = NULL;
+
+LogCategory::LogCategory(const char* name)
+    : _name(name)
+{
+    // Release builds only keep what went wrong, unless configured otherwise
+#ifdef DEBUG
+    _level = Logger::Debug;
+#else
+    _level = Logger::Warning;
+#endif
+
+    // Static initialization is single-threaded, so no need to lock
+    _next = first;
+    first = this;
+}
+
+LogMessage& LogMessage::arg(const QVariant& value) {
+    if (_argCount < MAXARGS)
+        _args[_argCount++] = value;
+    return *this;
+}
+
+QString LogMessage::toString() const {
+    QString result = _format ? QString(_format) : _text;
+    for (int i = 0; i < _argCount; ++i) {
+        // QVariant can't convert URLs to strings in Qt 4
+        if (_args[i].type() == QVariant::Url)
+            result = result.arg(_args[i].toUrl().toString());
+        else
+            result = result.arg(_args[i].toString());
+    }
+    return result;
+}
 
 Logger::Logger()
-    : _file("log.txt"), _fileStream(&_file)
-{}
+    : _file("log.txt")
+{
+    for (int i = 0; i < RINGSIZE; ++i)
+        _ring[i].sequence = i;
+    _dequeuePos = 0;
+    _droppedReported = 0;
+    _lastSecond = -1;
+    _writer = NULL;
+    _writtenPos = 0;
+    _flushRequested = false;
+    _stopping = false;
+    _writerIdle = 0;
+}
 
 Logger* Logger::instance() {
     return &instancePtr;
@@ -22,25 +85,258 @@ void Logger::initialize() {
         exit(EXIT_FAILURE);
     }
 
+    QString header;
     if (fileExists)
-        _fileStream << "\n";
-    _fileStream << QString("== LOG DATE ") + QDateTime::currentDateTime().toString() + "\n";
-    _fileStream << "This is " + QCoreApplication::applicationName() + " "
-                   + QCoreApplication::applicationVersion() + " reporting for duty.\n";
-}
+        header += "\n";
+    header += QString("== LOG DATE ") + QDateTime::currentDateTime().toString() + "\n";
+    header += "This is " + QCoreApplication::applicationName() + " "
+            + QCoreApplication::applicationVersion() + " reporting for duty.\n";
+    _file.write(header.toUtf8());
+    _file.flush();
+    configure(qgetenv("APTNOTIFIER_LOG"));
 
-void Logger::add(const QString& className, const QString& msg) {
-    Q_UNUSED(className)
-    Q_UNUSED(msg)
-#ifdef DEBUG
-    _fileLocker.lock();
-    assert(_file.isOpen() && _file.isWritable());
-    _fileStream << "[" + QDateTime::currentDateTime().toString("hh:mm:ss") + "] " + className + ": " + msg + "\n";
-    _fileStream.flush();
-    _fileLocker.unlock();
+    // Get whatever is still in the ring on disk if we crash
+    signal(SIGSEGV, &Logger::handleFatalSignal);
+    signal(SIGABRT, &Logger::handleFatalSignal);
+    signal(SIGFPE, &Logger::handleFatalSignal);
+    signal(SIGILL, &Logger::handleFatalSignal);
+#ifdef SIGBUS
+    signal(SIGBUS, &Logger::handleFatalSignal);
 #endif
+
+    _accepting = 1;
+    _writer = new LogWriter();
+    _writer->start(QThread::LowPriority);
+}
+
+void Logger::shutdown() {
+    if (!_writer)
+        return;
+
+    // Stop taking new messages, then let the writer finish the ring
+    _accepting = 0;
+    _writerLock.lock();
+    _stopping = true;
+    _writerWake.wakeOne();
+    _writerLock.unlock();
+    _writer->wait();
+    delete _writer;
+    _writer = NULL;
+
+    drain();
+    _file.close();
+}
+
+void Logger::flush() {
+    int target = _enqueuePos;
+
+    _writerLock.lock();
+    while (_writer && !_stopping && int(unsigned(target) - unsigned(_writtenPos)) > 0) {
+        _flushRequested = true;
+        _writerWake.wakeOne();
+        _flushed.wait(&_writerLock);
+    }
+    _writerLock.unlock();
+}
+
+void Logger::add(Level level, const char* className, void* object, const LogMessage& msg) {
+    if (!_accepting)
+        return;
+
+    Record record;
+    record.timestamp = QDateTime::currentMSecsSinceEpoch();
+    record.level = level;
+    record.className = className;
+    record.object = object;
+    record.msg = msg;
+    if (!push(record)) {
+        _dropped.fetchAndAddRelaxed(1);
+    } else if (_writerIdle.testAndSetOrdered(1, 0)) {
+        // The ring was empty and the writer went to sleep; only we need to wake it
+        _writerLock.lock();
+        _writerWake.wakeOne();
+        _writerLock.unlock();
+    }
+}
+
+void Logger::setLevel(const QString& className, Level level) {
+    for (LogCategory* category = LogCategory::first; category; category = category->_next) {
+        if (className == "*" || className == category->name())
+            category->setLevel(level);
+    }
+}
+
+void Logger::configure(const QString& spec) {
+    static const char* levelNames[] = { "trace", "debug", "info", "warning", "error", "off" };
+
+    // Entries are applied in order, so "*=info,Calendar=trace" works as expected
+    foreach (QString entry, spec.split(",", QString::SkipEmptyParts)) {
+        QStringList parts = entry.trimmed().split("=");
+        if (parts.size() != 2)
+            continue;
+
+        QString levelName = parts[1].trimmed().toLower();
+        for (int level = Trace; level <= Off; ++level) {
+            if (levelName == levelNames[level])
+                setLevel(parts[0].trimmed(), Level(level));
+        }
+    }
+}
+
+bool Logger::push(const Record& record) {
+    // Bounded MPMC queue after Dmitry Vyukov, used with a single consumer
+    int pos = _enqueuePos;
+    Slot* slot;
+    for (;;) {
+        slot = &_ring[unsigned(pos) & (RINGSIZE - 1)];
+        int seq = slot->sequence.fetchAndAddAcquire(0);
+        int dif = int(unsigned(seq) - unsigned(pos));
+        if (dif == 0) {
+            if (_enqueuePos.testAndSetRelaxed(pos, int(unsigned(pos) + 1)))
+                break;
+            pos = _enqueuePos;
+        } else if (dif < 0) {
+            return false;       // Full: the writer hasn't freed this slot yet
+        } else {
+            pos = _enqueuePos;  // Another producer took it
+        }
+    }
+
+    slot->record = record;
+    slot->sequence.fetchAndStoreRelease(int(unsigned(pos) + 1));
+    return true;
+}
+
+bool Logger::pop(Record& record) {
+    Slot& slot = _ring[unsigned(_dequeuePos) & (RINGSIZE - 1)];
+    int seq = slot.sequence.fetchAndAddAcquire(0);
+    if (int(unsigned(seq) - (unsigned(_dequeuePos) + 1)) < 0)
+        return false;
+
+    record = slot.record;
+    slot.record = Record();
+    slot.sequence.fetchAndStoreRelease(int(unsigned(_dequeuePos) + RINGSIZE));
+    _dequeuePos = int(unsigned(_dequeuePos) + 1);
+    return true;
+}
+
+bool Logger::ringEmpty() {
+    Slot& slot = _ring[unsigned(_dequeuePos) & (RINGSIZE - 1)];
+    int seq = slot.sequence.fetchAndAddAcquire(0);
+    return int(unsigned(seq) - (unsigned(_dequeuePos) + 1)) < 0;
+}
+
+bool Logger::drain() {
+    if (!_consumerBusy.testAndSetAcquire(0, 1))
+        return false;
+
+    QByteArray batch;
+    Record record;
+    bool wroteAny = false;
+    while (pop(record)) {
+        format(record, batch);
+        if (batch.size() >= BATCHBYTES) {
+            _file.write(batch);
+            batch.clear();
+            wroteAny = true;
+        }
+    }
+
+    // Tell the reader that part of the log is missing
+    int dropped = _dropped;
+    if (dropped != _droppedReported) {
+        Record note;
+        note.timestamp = QDateTime::currentMSecsSinceEpoch();
+        note.level = Warning;
+        note.className = CLASSNAME;
+        note.msg = LogMessage("%1 messages dropped, ring buffer was full").arg(dropped - _droppedReported);
+        format(note, batch);
+        _droppedReported = dropped;
+    }
+
+    if (!batch.isEmpty()) {
+        _file.write(batch);
+        wroteAny = true;
+    }
+    if (wroteAny)
+        _file.flush();
+
+    _consumerBusy.fetchAndStoreRelease(0);
+    return true;
 }
 
-void Logger::add(const QString& className, void* object, const QString& msg) {
-    add(className, msg + " " + objectTag(object));
+void Logger::writerLoop() {
+    _writerLock.lock();
+    for (;;) {
+        bool stopping = _stopping;
+        _writerLock.unlock();
+        drain();
+        _writerLock.lock();
+
+        _writtenPos = _dequeuePos;
+        _flushed.wakeAll();
+        if (stopping)
+            break;
+
+        if (!_flushRequested) {
+            // Nothing to batch: sleep until add(), flush() or shutdown() wakes us.
+            // add() checks the flag after publishing its record, and we check the
+            // ring after setting the flag, so one of us always sees the other.
+            _writerIdle.fetchAndStoreOrdered(1);
+            if (ringEmpty() && !_stopping)
+                _writerWake.wait(&_writerLock);
+            _writerIdle.fetchAndStoreOrdered(0);
+
+            // Let the messages that follow the first one join its batch
+            if (!_flushRequested && !_stopping)
+                _writerWake.wait(&_writerLock, WRITEINTERVAL);
+        }
+        _flushRequested = false;
+    }
+    _writerLock.unlock();
+}
+
+void Logger::format(const Record& record, QByteArray& out) {
+    // Many messages share the same second, so only format the time once per second
+    qint64 second = record.timestamp/1000;
+    if (second != _lastSecond) {
+        _lastSecond = second;
+        _lastTimeStr = QDateTime::fromMSecsSinceEpoch(record.timestamp).toString("hh:mm:ss").toUtf8();
+    }
+
+    out += "[";
+    out += _lastTimeStr;
+    out += "] ";
+    out += LEVELTAGS[record.level];
+    out += " ";
+    out += record.className;
+    out += ": ";
+    out += record.msg.toString().toUtf8();
+    if (record.object) {
+        out += " ";
+        out += objectTag(record.object).toUtf8();
+    }
+    out += "\n";
+}
+
+void Logger::emergencyFlush(int sig) {
+    // The writer may be in the middle of a batch; give it a moment to finish
+    for (int attempt = 0; attempt < 1000; ++attempt) {
+        if (drain()) {
+            QByteArray note = "== Fatal signal " + QByteArray::number(sig) + ", log flushed\n";
+            _file.write(note);
+            _file.flush();
+            return;
+        }
+        QThread::yieldCurrentThread();
+    }
+}
+
+void Logger::handleFatalSignal(int sig) {
+    FlightRecorder::instance()->record(FlightRecorder::FatalSignal, NULL, sig);
+    instancePtr.emergencyFlush(sig);
+
+    // Let the default action (core dump, crash reporter) take over
+    signal(sig, SIG_DFL);
+    raise(sig);
 }
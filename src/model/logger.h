@@ -4,10 +4,58 @@
 #include <QFile>
 #include <QMutex>
 #include <QString>
-#include <QTextStream>
+#include <QVariant>
+#include <QAtomicInt>
+#include <QWaitCondition>
+
+class LogWriter;
+class LogCategory;
+
+/**
+  * A log message whose formatting is left to the logger's writer thread. Build it
+  * like a QString with placeholders, e.g. LogMessage("Slide %1 of %2").arg(i).arg(n):
+  * the arguments are captured as they are and only turned into text by the writer.
+  * A plain QString works too, for messages that are already built.
+  * \author Pieter De Decker
+  */
+class LogMessage
+{
+public:
+    LogMessage(const char* format) : _format(format), _argCount(0) {}
+    LogMessage(const QString& text) : _format(NULL), _text(text), _argCount(0) {}
+    LogMessage() : _format(NULL), _argCount(0) {}
+
+    /** Captures the argument for the next %n placeholder. At most MAXARGS are kept. */
+    LogMessage& arg(const QVariant& value);
+
+    /** Produces the final text. Called on the writer thread. */
+    QString toString() const;
+
+    enum { MAXARGS = 4 };
+private:
+    const char* _format;
+    QString _text;
+    QVariant _args[MAXARGS];
+    int _argCount;
+};
 
 /**
   * Thread-safe class that logs various bits of information to a file.
+  *
+  * Use the LOG_TRACE ... LOG_ERROR macros rather than calling add() directly. Each
+  * class has a LogCategory (its CLASSNAME) with a runtime level; when a level is
+  * disabled, the macros skip the message arguments entirely. Levels can be set per
+  * class with setLevel() or the APTNOTIFIER_LOG environment variable, for example
+  * APTNOTIFIER_LOG="*=info,Calendar=trace".
+  *
+  * add() never waits for the disk: messages go into a bounded lock-free ring
+  * buffer and a background writer thread formats them and writes them to disk in
+  * batches. The writer sleeps while the ring is empty; the first message after
+  * that wakes it up and it collects messages for WRITEINTERVAL ms before writing.
+  * When the ring is full, new messages are dropped and counted; the writer notes
+  * the number of dropped messages in the log. The ring is flushed explicitly by
+  * flush() and shutdown(), and on a best-effort basis when the process receives
+  * a fatal signal.
   * \author Pieter De Decker
   */
 class Logger
@@ -17,16 +65,48 @@ private:
 public:
     static Logger* instance();
 
-    /** Opens log file for writing and writes header. Must be called before writing
-      * any log info! */
+    /** LOG LEVELS
+      *
+      * Trace
+      *     Very frequent events such as lock traffic. Compiled out of release builds.
+      * Debug
+      *     Step-by-step progress of refreshes, downloads and toasts.
+      * Info
+      *     Infrequent events worth keeping, such as calendars being added.
+      * Warning
+      *     Something went wrong, but the application recovers.
+      * Error
+      *     Something went wrong and a feature stops working.
+      * Off
+      *     Disables a category.
+      */
+    enum Level { Trace, Debug, Info, Warning, Error, Off };
+
+    /** Opens log file for writing, writes header and starts the writer thread. Must
+      * be called before writing any log info! */
     void initialize();
 
-    /** [THREAD-SAFE] Writes a message to the log file. */
-    void add(const QString& className, const QString &msg);
+    /** Writes out everything that was queued and stops the writer thread. Messages
+      * added afterwards are discarded. Call this before leaving main(). */
+    void shutdown();
 
-    /** [THREAD-SAFE] Writes a message to the log file, appending
-      * an object tag to keep track of the instance during the log. */
-    void add(const QString& className, void* object, const QString& msg);
+    /** [THREAD-SAFE] Blocks until every message added before the call is on disk. */
+    void flush();
+
+    /** [THREAD-SAFE] Queues a message for the log file. If 'object' isn't NULL, an
+      * object tag is appended to keep track of the instance during the log. Doesn't
+      * check the level; the LOG_* macros do that before building the message. */
+    void add(Level level, const char* className, void* object, const LogMessage& msg);
+
+    /** Sets the level of the category with the given class name, or of all
+      * categories if 'className' is "*". */
+    void setLevel(const QString& className, Level level);
+
+    /** Applies a comma-separated list of "ClassName=level" pairs. Unknown entries are ignored. */
+    void configure(const QString& spec);
+
+    /** [THREAD-SAFE] Number of messages dropped so far because the ring was full. */
+    int droppedCount() const { return _dropped; }
 
     /** Generates a 0xBAADF00D-style string for a given object. */
     static QString objectStr(void* object) {
@@ -42,12 +122,136 @@ public:
         return result;
     }
 
+    /** Capacity of the ring buffer. Must be a power of two. */
+    enum { RINGSIZE = 8192 };
 private:
+    friend class LogWriter;
+
+    /** A message as handed to add(). Formatting happens on the writer thread. */
+    struct Record {
+        Record() : timestamp(0), level(Debug), className(NULL), object(NULL) {}
+
+        qint64 timestamp;
+        Level level;
+        const char* className;
+        void* object;
+        LogMessage msg;
+    };
+
+    /** Ring buffer slot. 'sequence' tells producers and the writer whose turn it is. */
+    struct Slot {
+        QAtomicInt sequence;
+        Record record;
+    };
+
+    /** [THREAD-SAFE] Claims a slot and stores a record. Returns false if the ring is full. */
+    bool push(const Record& record);
+
+    /** [CONSUMER ONLY] Takes the oldest published record. Returns false if there is none. */
+    bool pop(Record& record);
+
+    /** Formats and writes all queued records. Returns false if another consumer
+      * is busy draining the ring. */
+    bool drain();
+
+    /** [CONSUMER ONLY] Whether the ring holds no published records. */
+    bool ringEmpty();
+
+    /** Main loop of the writer thread. */
+    void writerLoop();
+
+    /** Appends the formatted version of a record to 'out'. */
+    void format(const Record& record, QByteArray& out);
+
+    /** Drains the ring from a signal handler before the process dies. Best effort:
+      * gives up if the writer thread doesn't release the ring in time. */
+    void emergencyFlush(int sig);
+
+    static void handleFatalSignal(int sig);
+
+    static const char* CLASSNAME;
+    static const char* LEVELTAGS;
+    static const int WRITEINTERVAL;
+    static const int BATCHBYTES;
     static Logger instancePtr;
 
     QFile _file;
-    QMutex _fileLocker;
-    QTextStream _fileStream;
+
+    // Lock-free ring buffer
+    Slot _ring[RINGSIZE];
+    QAtomicInt _enqueuePos;
+    int _dequeuePos;
+    QAtomicInt _dropped;
+    int _droppedReported;
+    QAtomicInt _accepting;
+
+    /** Set while a thread drains the ring; guards the consumer side. */
+    QAtomicInt _consumerBusy;
+
+    /** Cached "hh:mm:ss" prefix of the last formatted second. Writer side only. */
+    qint64 _lastSecond;
+    QByteArray _lastTimeStr;
+
+    /** Set while the writer sleeps on an empty ring; the add() that clears it wakes
+      * the writer. */
+    QAtomicInt _writerIdle;
+
+    // Writer thread control. add() only takes the lock to wake an idle writer.
+    LogWriter* _writer;
+    QMutex _writerLock;
+    QWaitCondition _writerWake;
+    QWaitCondition _flushed;
+    int _writtenPos;
+    bool _flushRequested;
+    bool _stopping;
+};
+
+/**
+  * Runtime log level of a class. Declare one per class as 'static LogCategory CLASSNAME'
+  * and pass it to the LOG_* macros. Categories are static objects and register
+  * themselves with the Logger when constructed.
+  * \author Pieter De Decker
+  */
+class LogCategory
+{
+public:
+    LogCategory(const char* name);
+
+    const char* name() const { return _name; }
+
+    /** [THREAD-SAFE] Returns true if messages at 'level' get logged. */
+    bool isEnabled(Logger::Level level) const { return level >= int(_level); }
+
+    /** [THREAD-SAFE] Changes the level of this category. */
+    void setLevel(Logger::Level level) { _level = level; }
+private:
+    friend class Logger;
+
+    const char* _name;
+    QAtomicInt _level;
+    LogCategory* _next;
+
+    /** Head of the list of all categories. Plain pointer, so it's set before any
+      * category's constructor runs. */
+    static LogCategory* first;
 };
 
+/* Logging macros. The message expression is only evaluated if the level is enabled
+ * for the category. 'object' is the instance to tag the message with, or NULL. */
+#define LOG_AT(category, level, object, msg) \
+    do { \
+        if ((category).isEnabled(level)) \
+            Logger::instance()->add(level, (category).name(), object, msg); \
+    } while (0)
+
+#ifdef DEBUG
+#define LOG_TRACE(category, object, msg) LOG_AT(category, Logger::Trace, object, msg)
+#else
+#define LOG_TRACE(category, object, msg) do {} while (0)
+#endif
+#define LOG_DEBUG(category, object, msg) LOG_AT(category, Logger::Debug, object, msg)
+#define LOG_INFO(category, object, msg) LOG_AT(category, Logger::Info, object, msg)
+#define LOG_WARNING(category, object, msg) LOG_AT(category, Logger::Warning, object, msg)
+#define LOG_ERROR(category, object, msg) LOG_AT(category, Logger::Error, object, msg)
+
 #endif // LOGGER_H
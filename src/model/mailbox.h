@@ -0,0 +1,84 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <QAtomicInt>
+#include <QAtomicPointer>
+
+/**
+  * Unbounded lock-free multi-producer, single-consumer queue (after Dmitry Vyukov's
+  * MPSC node queue). Any thread may push(); only the owning thread may pop().
+  *
+  * push() reports whether the mailbox went from empty to non-empty, so the owner
+  * only needs to be woken once per batch of messages. After draining, the owner
+  * calls consumed() to find out whether messages arrived in the meantime.
+  *
+  * \author Pieter De Decker
+  */
+template <typename T>
+class Mailbox
+{
+public:
+    Mailbox() : _pending(0) {
+        Node* stub = new Node();
+        _head = stub;
+        _tail = stub;
+    }
+
+    ~Mailbox() {
+        T discarded;
+        while (pop(discarded)) {}
+        delete _tail;
+    }
+
+    /** [THREAD-SAFE] Appends a message. Returns true if the owner needs to be woken up. */
+    bool push(const T& value) {
+        Node* node = new Node(value);
+        Node* prev = _head.fetchAndStoreOrdered(node);
+        prev->next.fetchAndStoreRelease(node);
+        return _pending.fetchAndAddOrdered(1) == 0;
+    }
+
+    /** [OWNER ONLY] Takes the oldest message. Returns false if no message is visible yet. */
+    bool pop(T& value) {
+        Node* tail = _tail;
+        Node* next = tail->next.fetchAndAddAcquire(0);
+        if (!next)
+            return false;
+
+        // 'next' becomes the new stub, so its value can be moved out
+        value = next->value;
+        next->value = T();
+        _tail = next;
+        delete tail;
+        return true;
+    }
+
+    /** [OWNER ONLY] Reports that 'count' messages were popped. Returns true if more
+      * messages were pushed in the meantime and the owner should drain again. */
+    bool consumed(int count) {
+        return _pending.fetchAndAddOrdered(-count) - count > 0;
+    }
+private:
+    struct Node {
+        Node() : next(0) {}
+        Node(const T& v) : next(0), value(v) {}
+
+        QAtomicPointer<Node> next;
+        T value;
+    };
+
+    // Disable copying
+    Mailbox(const Mailbox&);
+    Mailbox& operator=(const Mailbox&);
+
+    /** Most recently pushed node. Shared between producers. */
+    QAtomicPointer<Node> _head;
+
+    /** Stub node in front of the oldest message. Owned by the consumer. */
+    Node* _tail;
+
+    /** Number of pushed messages that haven't been reported as consumed. */
+    QAtomicInt _pending;
+};
+
+#endif // MAILBOX_H
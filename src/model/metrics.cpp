@@ -0,0 +1,81 @@
+#include "metrics.h"
+
+#include <cassert>
+
+Metric* Metric::first = NULL;
+Metrics Metrics::instancePtr;
+
+Metric::Metric(const char* name, const char* help, Type type)
+    : _name(name), _help(help), _type(type)
+{
+    assert(name && help);
+
+    // Static initialization is single-threaded, so no need to lock
+    _next = first;
+    first = this;
+}
+
+Histogram::Histogram(const char* name, const char* help, const int* bounds, int boundCount)
+    : Metric(name, help, HistogramType), _bounds(bounds), _boundCount(boundCount)
+{
+    assert(bounds && 0 < boundCount && boundCount <= MAXBOUNDS);
+}
+
+Metrics::Metrics()
+{
+}
+
+Metrics* Metrics::instance() {
+    return &instancePtr;
+}
+
+QByteArray Metrics::exposition() {
+    static const char* typeNames[] = { "counter", "gauge", "histogram" };
+    QMutexLocker locker(&_collectLock);
+
+    QByteArray text;
+    for (Metric* metric = Metric::first; metric; metric = metric->_next) {
+        QByteArray name = metric->name();
+        text += "# HELP " + name + ' ' + metric->help() + '\n';
+        text += "# TYPE " + name + ' ' + typeNames[metric->type()] + '\n';
+
+        switch (metric->type()) {
+        case Metric::CounterType:
+            text += name + ' ' + QByteArray::number(static_cast<Counter*>(metric)->_count.collect()) + '\n';
+            break;
+        case Metric::GaugeType:
+            text += name + ' ' + QByteArray::number(static_cast<Gauge*>(metric)->value()) + '\n';
+            break;
+        case Metric::HistogramType: {
+            // Prometheus buckets are cumulative
+            Histogram* histogram = static_cast<Histogram*>(metric);
+            qint64 count = 0;
+            for (int i = 0; i <= histogram->_boundCount; ++i) {
+                count += histogram->_buckets[i].collect();
+                QByteArray bound = (i < histogram->_boundCount) ? QByteArray::number(histogram->_bounds[i]) : "+Inf";
+                text += name + "_bucket{le=\"" + bound + "\"} " + QByteArray::number(count) + '\n';
+            }
+            text += name + "_sum " + QByteArray::number(histogram->_sum.collect()) + '\n';
+            text += name + "_count " + QByteArray::number(count) + '\n';
+            break;
+        }
+        }
+    }
+
+    return text;
+}
+
+void Metrics::collect() {
+    QMutexLocker locker(&_collectLock);
+
+    for (Metric* metric = Metric::first; metric; metric = metric->_next) {
+        if (metric->type() == Metric::CounterType) {
+            static_cast<Counter*>(metric)->_count.collect();
+        } else if (metric->type() == Metric::HistogramType) {
+            Histogram* histogram = static_cast<Histogram*>(metric);
+            for (int i = 0; i <= histogram->_boundCount; ++i)
+                histogram->_buckets[i].collect();
+            histogram->_sum.collect();
+        }
+    }
+}
@@ -0,0 +1,157 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QMutex>
+#include <QAtomicInt>
+#include <QByteArray>
+
+/**
+  * A 32-bit event count that Metrics widens to 64 bits when it collects it. The
+  * recording side is a single relaxed atomic add; collect() adds the difference
+  * since the previous collection, so the total stays exact as long as fewer than
+  * 2^32 events happen between two collections.
+  * \author Pieter De Decker
+  */
+class MetricWord
+{
+public:
+    MetricWord() : _value(0), _seen(0), _total(0) {}
+
+    /** [THREAD-SAFE] Adds 'n', which must not be negative. */
+    void add(int n) { _value.fetchAndAddRelaxed(n); }
+
+    /** Returns the 64-bit total. Only Metrics calls this, under its lock. */
+    qint64 collect() {
+        quint32 value = quint32(int(_value));
+        _total += quint32(value - _seen);
+        _seen = value;
+        return _total;
+    }
+private:
+    QAtomicInt _value;
+    quint32 _seen;
+    qint64 _total;
+};
+
+/**
+  * Base class of all runtime metrics. Like LogCategory, metrics are static objects
+  * that register themselves when constructed; Metrics walks the list when it
+  * exports them. Names follow the Prometheus conventions, with the unit in the
+  * name, e.g. "aptnotifier_http_request_duration_milliseconds".
+  * \author Pieter De Decker
+  */
+class Metric
+{
+public:
+    enum Type { CounterType, GaugeType, HistogramType };
+
+    const char* name() const { return _name; }
+    const char* help() const { return _help; }
+    Type type() const { return _type; }
+protected:
+    Metric(const char* name, const char* help, Type type);
+private:
+    friend class Metrics;
+
+    // Disable copying
+    Metric(const Metric&);
+    Metric& operator=(const Metric&);
+
+    const char* _name;
+    const char* _help;
+    Type _type;
+    Metric* _next;
+
+    /** Head of the list of all metrics. Plain pointer, so it's set before any
+      * metric's constructor runs. */
+    static Metric* first;
+};
+
+/** Counts events or amounts that only go up, such as requests or bytes. */
+class Counter : public Metric
+{
+public:
+    Counter(const char* name, const char* help) : Metric(name, help, CounterType) {}
+
+    /** [THREAD-SAFE] Adds 'n', which must not be negative. */
+    void add(int n = 1) { _count.add(n); }
+private:
+    friend class Metrics;
+
+    MetricWord _count;
+};
+
+/** Holds a value that goes up and down, such as a queue depth. */
+class Gauge : public Metric
+{
+public:
+    Gauge(const char* name, const char* help) : Metric(name, help, GaugeType), _value(0) {}
+
+    /** [THREAD-SAFE] Replaces the value. */
+    void set(int value) { _value = value; }
+
+    /** [THREAD-SAFE] Adds 'delta', which may be negative. */
+    void add(int delta) { _value.fetchAndAddRelaxed(delta); }
+
+    int value() const { return _value; }
+private:
+    QAtomicInt _value;
+};
+
+/**
+  * Counts observations in fixed buckets. 'bounds' are the inclusive upper bounds
+  * of the buckets in ascending order, at most MAXBOUNDS of them; an extra bucket
+  * catches everything above the last bound. The array must outlive the histogram.
+  */
+class Histogram : public Metric
+{
+public:
+    Histogram(const char* name, const char* help, const int* bounds, int boundCount);
+
+    enum { MAXBOUNDS = 16 };
+
+    /** [THREAD-SAFE] Records one observation. Negative values count as 0. */
+    void observe(int value) {
+        if (value < 0)
+            value = 0;
+        int bucket = 0;
+        while (bucket < _boundCount && value > _bounds[bucket])
+            ++bucket;
+        _buckets[bucket].add(1);
+        _sum.add(value);
+    }
+private:
+    friend class Metrics;
+
+    const int* _bounds;
+    int _boundCount;
+    MetricWord _buckets[MAXBOUNDS + 1];
+    MetricWord _sum;
+};
+
+/**
+  * Exports all registered metrics in the Prometheus text format. Recording never
+  * goes through this class; it only reads the metrics when asked for a snapshot.
+  * \author Pieter De Decker
+  */
+class Metrics
+{
+private:
+    Metrics();
+public:
+    static Metrics* instance();
+
+    /** [THREAD-SAFE] All metrics in the Prometheus text exposition format. */
+    QByteArray exposition();
+
+    /** [THREAD-SAFE] Widens all counters without exporting them. Must run often
+      * enough that no counter moves by 2^32 in between; see MetricWord. */
+    void collect();
+private:
+    static Metrics instancePtr;
+
+    /** Serializes collections, which update the 64-bit totals. */
+    QMutex _collectLock;
+};
+
+#endif // METRICS_H
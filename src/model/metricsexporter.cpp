@@ -0,0 +1,75 @@
+#include "metricsexporter.h"
+
+#include "metrics.h"
+#include "fileutil.h"
+#include "calendar.h"
+#include "calendardb.h"
+#include <cassert>
+#include <QLocalSocket>
+
+LogCategory MetricsExporter::CLASSNAME("MetricsExporter");
+const int MetricsExporter::EXPORTINTERVAL = 15000;
+
+MetricsExporter::MetricsExporter(CalendarDB* calDB, QObject* parent)
+    : QObject(parent), _exportTimer(this), _server(this)
+{
+    assert(calDB);
+    _calDB = calDB;
+    connect(&_exportTimer, SIGNAL(timeout()), this, SLOT(exportTick()));
+    connect(&_server, SIGNAL(newConnection()), this, SLOT(serveClients()));
+}
+
+bool MetricsExporter::start(const QString& target) {
+    if (target.startsWith("file:") && target.length() > 5) {
+        _path = target.mid(5);
+        writeFile();
+    } else if (target.startsWith("socket:") && target.length() > 7) {
+        QString name = target.mid(7);
+        if (!_server.listenExclusive(name)) {
+            LOG_WARNING(CLASSNAME, this, LogMessage("Can't listen on %1: %2").arg(name).arg(_server.errorString()));
+            return false;
+        }
+    } else {
+        if (!target.isEmpty())
+            LOG_WARNING(CLASSNAME, this, LogMessage("Unknown metrics target '%1'").arg(target));
+        return false;
+    }
+
+    _exportTimer.start(EXPORTINTERVAL);
+    LOG_INFO(CLASSNAME, this, LogMessage("Exporting metrics to %1").arg(target));
+    return true;
+}
+
+QByteArray MetricsExporter::exposition() {
+    QByteArray text = Metrics::instance()->exposition();
+
+    // Per-calendar figures come straight from the published state
+    text += "# HELP aptnotifier_calendar_events Events in the calendar as of its last parse\n";
+    text += "# TYPE aptnotifier_calendar_events gauge\n";
+    foreach (Calendar* cal, _calDB->calendars().calendars()) {
+        text += "aptnotifier_calendar_events{calendar=\"" + QByteArray::number(cal->id()) + "\"} "
+                + QByteArray::number(cal->timeline().size()) + '\n';
+    }
+
+    return text;
+}
+
+void MetricsExporter::exportTick() {
+    if (_path.isEmpty())
+        Metrics::instance()->collect();
+    else
+        writeFile();
+}
+
+void MetricsExporter::writeFile() {
+    if (!FileUtil::writeAtomically(_path, exposition()))
+        LOG_WARNING(CLASSNAME, this, LogMessage("Can't write metrics to %1").arg(_path));
+}
+
+void MetricsExporter::serveClients() {
+    while (QLocalSocket* socket = _server.nextPendingConnection()) {
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+        socket->write(exposition());
+        socket->disconnectFromServer();
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+#include "logger.h"
+#include "exclusivelocalserver.h"
+#include <QTimer>
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+class CalendarDB;
+
+/**
+  * Publishes the Metrics registry in the Prometheus text format, together with a
+  * gauge of the number of events in every calendar. 'target' is either
+  *
+  *   file:<path>      Rewritten atomically every EXPORTINTERVAL milliseconds, for
+  *                    node_exporter's textfile collector and the like.
+  *   socket:<name>    A local socket; every client that connects gets the current
+  *                    metrics and is disconnected.
+  *
+  * In both modes, the counters are collected every EXPORTINTERVAL milliseconds so
+  * they can't wrap between two scrapes.
+  *
+  * Lives on CalendarDB's thread.
+  * \author Pieter De Decker
+  */
+class MetricsExporter : public QObject
+{
+    Q_OBJECT
+public:
+    MetricsExporter(CalendarDB* calDB, QObject* parent = 0);
+
+    /** Starts exporting to 'target'. Returns false if the target is empty or
+      * invalid, or if the socket can't be opened or belongs to another instance. */
+    bool start(const QString& target);
+
+    /** Everything this exporter publishes, in the Prometheus text format. */
+    QByteArray exposition();
+
+    static const int EXPORTINTERVAL;
+private:
+    static LogCategory CLASSNAME;
+
+    CalendarDB* _calDB;
+    QString _path;
+    QTimer _exportTimer;
+    ExclusiveLocalServer _server;
+private slots:
+    /** Collects the counters and, when exporting to a file, rewrites it. */
+    void exportTick();
+
+    /** Rewrites the metrics file. */
+    void writeFile();
+
+    /** Sends the metrics to every pending client. */
+    void serveClients();
+};
+
+#endif // METRICSEXPORTER_H
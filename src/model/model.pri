@@ -0,0 +1,59 @@
+# Model layer: calendar fetching, parsing and caching. Shared by the
+# application, the headless daemon in daemon/ and the benchmark tools in
+# bench/. Only uses QtCore and QtNetwork, so it builds with QT -= gui.
+
+QT += network
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    $$PWD/appointment.cpp \
+    $$PWD/calendar.cpp \
+    $$PWD/calendardb.cpp \
+    $$PWD/logger.cpp \
+    $$PWD/aptcache.cpp \
+    $$PWD/httpdownloader.cpp \
+    $$PWD/icsparser.cpp \
+    $$PWD/fetchscheduler.cpp \
+    $$PWD/fileutil.cpp \
+    $$PWD/bodycache.cpp \
+    $$PWD/utf8.cpp \
+    $$PWD/localfilesource.cpp \
+    $$PWD/calendarshard.cpp \
+    $$PWD/lockprofiler.cpp \
+    $$PWD/flightrecorder.cpp \
+    $$PWD/configstore.cpp \
+    $$PWD/calendarregistry.cpp \
+    $$PWD/notificationdispatcher.cpp \
+    $$PWD/exclusivelocalserver.cpp \
+    $$PWD/queryserver.cpp \
+    $$PWD/metrics.cpp \
+    $$PWD/metricsexporter.cpp \
+    $$PWD/searchindex.cpp \
+    $$PWD/filterrules.cpp
+
+HEADERS += \
+    $$PWD/appointment.h \
+    $$PWD/calendar.h \
+    $$PWD/calendardb.h \
+    $$PWD/logger.h \
+    $$PWD/aptcache.h \
+    $$PWD/httpdownloader.h \
+    $$PWD/icsparser.h \
+    $$PWD/fetchscheduler.h \
+    $$PWD/fileutil.h \
+    $$PWD/bodycache.h \
+    $$PWD/utf8.h \
+    $$PWD/localfilesource.h \
+    $$PWD/mailbox.h \
+    $$PWD/calendarshard.h \
+    $$PWD/lockprofiler.h \
+    $$PWD/flightrecorder.h \
+    $$PWD/configstore.h \
+    $$PWD/calendarregistry.h \
+    $$PWD/notificationdispatcher.h \
+    $$PWD/exclusivelocalserver.h \
+    $$PWD/queryserver.h \
+    $$PWD/metrics.h \
+    $$PWD/metricsexporter.h \
+    $$PWD/searchindex.h \
+    $$PWD/filterrules.h
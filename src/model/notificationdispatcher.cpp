@@ -0,0 +1,103 @@
+#include "notificationdispatcher.h"
+
+#include <QHash>
+#include <cassert>
+#include <QDateTime>
+#include <QCoreApplication>
+
+LogCategory NotificationDispatcher::CLASSNAME("NotificationDispatcher");
+const int NotificationDispatcher::TICKINTERVAL = 30000;
+const int NotificationDispatcher::COLLECTWINDOW = 500;
+const int NotificationDispatcher::DEFAULTSUMMARYTHRESHOLD = 10;
+const QEvent::Type NotificationDispatcher::WAKEEVENT = static_cast<QEvent::Type>(QEvent::registerEventType());
+
+NotificationDispatcher::NotificationDispatcher(QObject* parent)
+    : QObject(parent), _collectTimer(this)
+{
+    _summaryThreshold = DEFAULTSUMMARYTHRESHOLD;
+    _collectTimer.setSingleShot(true);
+    _collectTimer.setInterval(COLLECTWINDOW);
+    connect(&_collectTimer, SIGNAL(timeout()), this, SLOT(dispatch()));
+}
+
+void NotificationDispatcher::setSummaryThreshold(int threshold) {
+    assert(threshold > 0);
+    _summaryThreshold = threshold;
+}
+
+int NotificationDispatcher::msecsToNextTick() {
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    return TICKINTERVAL - int(now % TICKINTERVAL);
+}
+
+void NotificationDispatcher::queueOngoing(int calendarId, const QList<Appointment>& list) {
+    Report report;
+    report.kind = Notification::Ongoing;
+    report.calendarId = calendarId;
+    report.list = list;
+    post(report);
+}
+
+void NotificationDispatcher::queueReminders(int calendarId, const QList<Appointment>& list) {
+    Report report;
+    report.kind = Notification::Reminder;
+    report.calendarId = calendarId;
+    report.list = list;
+    post(report);
+}
+
+void NotificationDispatcher::post(const Report& report) {
+    // Only the first report of a tick needs to wake us up
+    if (_mailbox.push(report))
+        QCoreApplication::postEvent(this, new QEvent(WAKEEVENT));
+}
+
+bool NotificationDispatcher::event(QEvent* e) {
+    if (e->type() == WAKEEVENT) {
+        if (!_collectTimer.isActive())
+            _collectTimer.start();
+        return true;
+    }
+
+    return QObject::event(e);
+}
+
+void NotificationDispatcher::dispatch() {
+    QList<Report> reports;
+    Report report;
+    while (_mailbox.pop(report))
+        reports.append(report);
+
+    // Reports that came in while we were draining belong to the next batch
+    if (_mailbox.consumed(reports.size()))
+        _collectTimer.start();
+
+    // Ongoing appointments go first, and every appointment only once per kind
+    QList<Notification> batch;
+    for (int kind = Notification::Ongoing; kind <= Notification::Reminder; ++kind) {
+        QHash<QString, int> seen;
+        foreach (const Report& r, reports) {
+            if (r.kind != kind)
+                continue;
+
+            foreach (const Appointment& apt, r.list) {
+                QString key = apt.summary() + '\x1f' + apt.start().toString(Qt::ISODate)
+                        + '\x1f' + apt.end().toString(Qt::ISODate);
+                QHash<QString, int>::const_iterator it = seen.constFind(key);
+                if (it == seen.constEnd()) {
+                    seen.insert(key, batch.size());
+                    batch.append(Notification(r.kind, r.calendarId, apt));
+                } else if (apt.priority() == Appointment::Escalated
+                           && batch[*it].apt.priority() != Appointment::Escalated) {
+                    // A filter rule may escalate the copy in only one calendar; keep that one
+                    batch.replace(*it, Notification(r.kind, r.calendarId, apt));
+                }
+            }
+        }
+    }
+
+    if (batch.isEmpty())
+        return;
+    LOG_DEBUG(CLASSNAME, this, LogMessage("Dispatching %1 notifications from %2 reports").arg(batch.size()).arg(reports.size()));
+    emit notificationsDue(batch);
+}
@@ -0,0 +1,96 @@
+#ifndef NOTIFICATIONDISPATCHER_H
+#define NOTIFICATIONDISPATCHER_H
+
+#include "logger.h"
+#include "mailbox.h"
+#include "appointment.h"
+#include <QList>
+#include <QEvent>
+#include <QTimer>
+#include <QObject>
+
+/**
+  * A single ongoing appointment or reminder, as reported by a calendar.
+  */
+struct Notification {
+    enum Kind { Ongoing, Reminder };
+
+    Notification(Kind k, int id, const Appointment& a) : kind(k), calendarId(id), apt(a) {}
+
+    Kind kind;
+    int calendarId;
+    Appointment apt;
+};
+
+/**
+  * Collects the notifications of all calendars and hands them to the view in one
+  * batch per notification tick. Calendars check their notifications on the same
+  * wall-clock tick (see msecsToNextTick), so their reports arrive together; the
+  * dispatcher waits COLLECTWINDOW ms after the first one before sending the
+  * batch. An appointment reported by several calendars, or twice by the same
+  * one, appears in the batch only once; if any copy is escalated, that one wins.
+  *
+  * Calendars report through a lock-free mailbox, so only the first report of a
+  * tick crosses threads as an event. The queue* slots are [THREAD-SAFE] and meant
+  * for direct connections; everything else runs on the dispatcher's thread.
+  * \author Pieter De Decker
+  */
+class NotificationDispatcher : public QObject
+{
+    Q_OBJECT
+public:
+    NotificationDispatcher(QObject* parent = 0);
+
+    /** Batches with at least this many notifications of one kind should be shown
+      * as a summary rather than one by one. */
+    int summaryThreshold() const { return _summaryThreshold; }
+    void setSummaryThreshold(int threshold);
+
+    /** Milliseconds until the next notification tick. Ticks are aligned to
+      * multiples of TICKINTERVAL since the epoch. */
+    static int msecsToNextTick();
+
+    static const int TICKINTERVAL;
+    static const int COLLECTWINDOW;
+    static const int DEFAULTSUMMARYTHRESHOLD;
+public slots:
+    /** [THREAD-SAFE] Queues newly ongoing appointments of a calendar. */
+    void queueOngoing(int calendarId, const QList<Appointment>& list);
+
+    /** [THREAD-SAFE] Queues reminders of a calendar. */
+    void queueReminders(int calendarId, const QList<Appointment>& list);
+protected:
+    /** Starts the collect window when a WAKEEVENT arrives. */
+    bool event(QEvent* e);
+private:
+    static LogCategory CLASSNAME;
+
+    /** One report from a calendar. */
+    struct Report {
+        Report() : kind(Notification::Ongoing), calendarId(-1) {}
+
+        Notification::Kind kind;
+        int calendarId;
+        QList<Appointment> list;
+    };
+
+    /** [THREAD-SAFE] Drops a report in the mailbox and wakes up the dispatcher if
+      * it was empty. */
+    void post(const Report& report);
+
+    Mailbox<Report> _mailbox;
+    QTimer _collectTimer;
+    int _summaryThreshold;
+
+    static const QEvent::Type WAKEEVENT;
+private slots:
+    /** Drains the mailbox, merges duplicates and emits the batch. Duplicates keep
+      * their first position, but an escalated copy replaces a plain one. */
+    void dispatch();
+signals:
+    /** Broadcasts the notifications of one tick: ongoing appointments first, then
+      * reminders, each in the order they were reported. */
+    void notificationsDue(const QList<Notification>& batch);
+};
+
+#endif // NOTIFICATIONDISPATCHER_H
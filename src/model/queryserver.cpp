@@ -0,0 +1,178 @@
+#include "queryserver.h"
+
+#include "calendar.h"
+#include "calendardb.h"
+#include "fetchscheduler.h"
+#include "lockprofiler.h"
+#include <cassert>
+#include <algorithm>
+#include <QLocalSocket>
+
+LogCategory QueryServer::CLASSNAME("QueryServer");
+const char* QueryServer::BASENAME = "aptnotifier";
+const int QueryServer::MAXREQUEST = 1024;
+const int QueryServer::MAXRESULTS = 10000;
+
+/** Orders appointments on start time, for binary searches in a timeline. */
+static bool startsBefore(const Appointment& apt, const QDateTime& time) {
+    return apt.start() < time;
+}
+
+QueryServer::QueryServer(CalendarDB* calDB, QObject* parent)
+    : QObject(parent), _server(this)
+{
+    assert(calDB);
+    _calDB = calDB;
+    connect(&_server, SIGNAL(newConnection()), this, SLOT(acceptConnections()));
+}
+
+QString QueryServer::defaultName() {
+    return ExclusiveLocalServer::perUserName(BASENAME);
+}
+
+bool QueryServer::listen(const QString& name) {
+    if (!_server.listenExclusive(name)) {
+        LOG_WARNING(CLASSNAME, this, LogMessage("Can't listen on %1: %2").arg(name).arg(_server.errorString()));
+        return false;
+    }
+
+    LOG_INFO(CLASSNAME, this, LogMessage("Listening on %1").arg(name));
+    return true;
+}
+
+void QueryServer::acceptConnections() {
+    while (QLocalSocket* socket = _server.nextPendingConnection()) {
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readRequests()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+void QueryServer::readRequests() {
+    QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
+    assert(socket);
+
+    while (socket->canReadLine())
+        socket->write(answer(socket->readLine(MAXREQUEST).trimmed()));
+
+    // A client that keeps sending without a newline isn't speaking our protocol
+    if (socket->bytesAvailable() > MAXREQUEST) {
+        socket->write(error("request too long"));
+        socket->disconnectFromServer();
+    }
+}
+
+QByteArray QueryServer::answer(const QByteArray& request) {
+    QList<QByteArray> words = request.split(' ');
+    const QByteArray& command = words.first();
+    LOG_DEBUG(CLASSNAME, this, LogMessage("Query: %1").arg(QString(request)));
+
+    if (command == "next" && words.size() == 2) {
+        bool valid;
+        int count = words[1].toInt(&valid);
+        if (!valid || count < 0)
+            return error("bad count");
+        return formatHits(eventsBetween(QDateTime::currentDateTime(), QDateTime(), std::min(count, MAXRESULTS)));
+    }
+
+    if (command == "window" && words.size() == 3) {
+        QDateTime from = QDateTime::fromString(words[1], Qt::ISODate);
+        QDateTime to = QDateTime::fromString(words[2], Qt::ISODate);
+        if (!from.isValid() || !to.isValid())
+            return error("bad time");
+        return formatHits(eventsBetween(from, to, MAXRESULTS));
+    }
+
+    if (command == "search" && words.size() >= 2) {
+        QString query = QString::fromUtf8(request.mid(command.size() + 1));
+        return formatHits(search(query, MAXRESULTS));
+    }
+
+    if (command == "status" && words.size() == 1) {
+        static const char* statusNames[] = { "notloaded", "online", "offline" };
+        QStringList lines;
+        foreach (Calendar* cal, _calDB->calendars().calendars()) {
+            lines.append(QString::number(cal->id()) + '\t' + statusNames[cal->status()]
+                         + '\t' + cal->nextRefresh().toString(Qt::ISODate)
+                         + '\t' + cal->name() + '\t' + cal->url().toString());
+        }
+        return ok(lines);
+    }
+
+    if (command == "locks" && words.size() == 1)
+        return ok(LockProfiler::instance()->report().split('\n', QString::SkipEmptyParts));
+
+    if (command == "fetches" && words.size() == 1)
+        return ok(QStringList() << FetchScheduler::instance()->statsString());
+
+    return error("unknown request");
+}
+
+QList<QueryServer::Hit> QueryServer::eventsBetween(const QDateTime& from, const QDateTime& to, int limit) {
+    // Timelines are sorted on start time: find where each one enters the range...
+    QList<Cursor> cursors;
+    foreach (Calendar* cal, _calDB->calendars().calendars()) {
+        Cursor cursor;
+        cursor.calendarId = cal->id();
+        cursor.timeline = cal->timeline();
+        cursor.pos = std::lower_bound(cursor.timeline.constBegin(), cursor.timeline.constEnd(), from, startsBefore);
+        if (cursor.pos != cursor.timeline.constEnd())
+            cursors.append(cursor);
+    }
+
+    // ...then merge them until we have enough
+    QList<Hit> hits;
+    while (hits.size() < limit) {
+        int best = -1;
+        for (int i = 0; i < cursors.size(); ++i) {
+            if (cursors[i].pos == cursors[i].timeline.constEnd())
+                continue;
+            if (best < 0 || cursors[i].pos->start() < cursors[best].pos->start())
+                best = i;
+        }
+        if (best < 0 || (to.isValid() && cursors[best].pos->start() >= to))
+            break;
+
+        hits.append(Hit(cursors[best].calendarId, *cursors[best].pos));
+        ++cursors[best].pos;
+    }
+
+    return hits;
+}
+
+QList<QueryServer::Hit> QueryServer::search(const QString& query, int limit) {
+    QList<Hit> hits;
+    foreach (Calendar* cal, _calDB->calendars().calendars()) {
+        foreach (const Appointment& apt, cal->search(query, limit))
+            hits.append(Hit(cal->id(), apt));
+    }
+
+    std::stable_sort(hits.begin(), hits.end(), startsEarlier);
+    return hits.mid(0, limit);
+}
+
+bool QueryServer::startsEarlier(const Hit& a, const Hit& b) {
+    return a.apt.start() < b.apt.start();
+}
+
+QByteArray QueryServer::formatHits(const QList<Hit>& hits) {
+    QStringList lines;
+    foreach (const Hit& hit, hits) {
+        // Summaries can't break the line structure
+        QString summary = hit.apt.summary();
+        summary.replace('\t', ' ').replace('\n', ' ').replace('\r', ' ');
+        lines.append(hit.apt.start().toString(Qt::ISODate) + '\t' + hit.apt.end().toString(Qt::ISODate)
+                     + '\t' + QString::number(hit.calendarId) + '\t' + summary);
+    }
+    return ok(lines);
+}
+
+QByteArray QueryServer::ok(const QStringList& lines) {
+    QByteArray response = "OK " + QByteArray::number(lines.size()) + '\n';
+    foreach (const QString& line, lines)
+        response += line.toUtf8() + '\n';
+    return response;
+}
+
+QByteArray QueryServer::error(const QString& reason) {
+    return "ERR " + reason.toUtf8() + '\n';
+}
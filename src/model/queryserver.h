@@ -0,0 +1,102 @@
+#ifndef QUERYSERVER_H
+#define QUERYSERVER_H
+
+#include "logger.h"
+#include "appointment.h"
+#include "exclusivelocalserver.h"
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QDateTime>
+#include <QByteArray>
+#include <QStringList>
+class CalendarDB;
+class QLocalSocket;
+
+/**
+  * Answers questions about upcoming events over a local socket (a UNIX domain
+  * socket, or a named pipe on Windows), straight from the calendars' in-memory
+  * timelines. Nothing is read from disk or the network to answer a query.
+  *
+  * Requests are single lines; responses are "OK <n>" followed by n lines, or
+  * "ERR <reason>". Fields are separated by tabs and times are ISO 8601.
+  *
+  *   next <n>              The next n events that haven't started yet:
+  *                         start, end, calendar ID, summary
+  *   window <from> <to>    Events starting in [from, to), in the same format
+  *   search <terms>        Events whose summary contains all terms, in the same
+  *                         format. "term*" matches words starting with "term".
+  *   status                One line per calendar: ID, status, next refresh,
+  *                         name, URL
+  *   locks                 The LockProfiler report, one line per lock site
+  *   fetches               One line with the FetchScheduler's queue statistics
+  *
+  * Lives on CalendarDB's thread.
+  * \author Pieter De Decker
+  */
+class QueryServer : public QObject
+{
+    Q_OBJECT
+public:
+    QueryServer(CalendarDB* calDB, QObject* parent = 0);
+
+    /** Starts listening on 'name', replacing a socket left behind by a crashed
+      * instance. Returns false if that fails or another instance owns the name. */
+    bool listen(const QString& name = defaultName());
+
+    /** "aptnotifier-<user>", so that users sharing a host each get their own. */
+    static QString defaultName();
+
+    static const char* BASENAME;
+    static const int MAXREQUEST;
+    static const int MAXRESULTS;
+private:
+    static LogCategory CLASSNAME;
+
+    /** Appointment of a calendar, as found by a query. */
+    struct Hit {
+        Hit(int i, const Appointment& a) : calendarId(i), apt(a) {}
+
+        int calendarId;
+        Appointment apt;
+    };
+
+    /** Position in the timeline of one calendar while merging. */
+    struct Cursor {
+        int calendarId;
+        QList<Appointment> timeline;
+        QList<Appointment>::const_iterator pos;
+    };
+
+    /** Answers a single request line. */
+    QByteArray answer(const QByteArray& request);
+
+    /** Collects up to 'limit' events starting in [from, to) from all calendars,
+      * sorted on start time. */
+    QList<Hit> eventsBetween(const QDateTime& from, const QDateTime& to, int limit);
+
+    /** Collects up to 'limit' events that match 'query' from all calendars, sorted
+      * on start time. */
+    QList<Hit> search(const QString& query, int limit);
+
+    /** Orders hits on start time. */
+    static bool startsEarlier(const Hit& a, const Hit& b);
+
+    /** Formats hits as response lines. */
+    static QByteArray formatHits(const QList<Hit>& hits);
+
+    /** Formats a response. */
+    static QByteArray ok(const QStringList& lines);
+    static QByteArray error(const QString& reason);
+
+    CalendarDB* _calDB;
+    ExclusiveLocalServer _server;
+private slots:
+    /** Accepts pending connections. */
+    void acceptConnections();
+
+    /** Answers the complete request lines a client sent. */
+    void readRequests();
+};
+
+#endif // QUERYSERVER_H
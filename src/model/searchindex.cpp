@@ -0,0 +1,179 @@
+#include "searchindex.h"
+
+#include <iterator>
+#include <algorithm>
+#include <QReadLocker>
+#include <QWriteLocker>
+
+uint qHash(const SearchIndex::Key& key) {
+    return ::qHash(key.start) ^ ::qHash(key.end) ^ ::qHash(key.summary);
+}
+
+namespace {
+    /** Orders appointments on start time. */
+    bool startsEarlier(const Appointment& a, const Appointment& b) {
+        return a.start() < b.start();
+    }
+
+    /** Keeps the IDs that occur in both sorted lists. */
+    QVector<int> intersect(const QVector<int>& a, const QVector<int>& b) {
+        QVector<int> result;
+        std::set_intersection(a.constBegin(), a.constEnd(), b.constBegin(), b.constEnd(), std::back_inserter(result));
+        return result;
+    }
+}
+
+SearchIndex::SearchIndex()
+    : _nextId(0)
+{
+}
+
+SearchIndex::Diff SearchIndex::diff(const QList<Appointment>& oldTimeline, const QList<Appointment>& newTimeline) {
+    // Count what the old timeline had, then cross off what the new one still has
+    QHash<Key, int> remaining;
+    foreach (const Appointment& apt, oldTimeline)
+        ++remaining[Key(apt)];
+
+    Diff result;
+    foreach (const Appointment& apt, newTimeline) {
+        QHash<Key, int>::iterator it = remaining.find(Key(apt));
+        if (it != remaining.end() && *it > 0)
+            --*it;
+        else
+            result.added.append(apt);
+    }
+
+    foreach (const Appointment& apt, oldTimeline) {
+        QHash<Key, int>::iterator it = remaining.find(Key(apt));
+        if (*it > 0) {
+            --*it;
+            result.removed.append(apt);
+        }
+    }
+
+    return result;
+}
+
+void SearchIndex::apply(const Diff& diff) {
+    QWriteLocker locker(&_lock);
+
+    foreach (const Appointment& apt, diff.removed) {
+        QMultiHash<Key, int>::iterator it = _ids.find(Key(apt));
+        if (it == _ids.end())
+            continue;
+
+        removePostings(*it, apt);
+        _events.remove(*it);
+        _ids.erase(it);
+    }
+
+    foreach (const Appointment& apt, diff.added) {
+        int id = _nextId++;
+        _events.insert(id, apt);
+        _ids.insert(Key(apt), id);
+        addPostings(id, apt);
+    }
+}
+
+QList<Appointment> SearchIndex::search(const QString& query, int limit) {
+    // Terms are split like summaries; only the last word of a "term*" is a prefix
+    QStringList words;
+    QList<bool> prefixes;
+    foreach (const QString& term, query.split(' ', QString::SkipEmptyParts)) {
+        QStringList termWords = tokenize(term);
+        for (int i = 0; i < termWords.size(); ++i) {
+            words.append(termWords[i]);
+            prefixes.append(i == termWords.size() - 1 && term.endsWith('*'));
+        }
+    }
+    if (words.isEmpty())
+        return QList<Appointment>();
+
+    QReadLocker locker(&_lock);
+
+    // Start with the rarest word, so the intersections stay small
+    QList<QVector<int> > lists;
+    for (int i = 0; i < words.size(); ++i) {
+        QVector<int> postings = postingsFor(words[i], prefixes[i]);
+        if (postings.isEmpty())
+            return QList<Appointment>();
+        lists.append(postings);
+    }
+
+    int rarest = 0;
+    for (int i = 1; i < lists.size(); ++i) {
+        if (lists[i].size() < lists[rarest].size())
+            rarest = i;
+    }
+    QVector<int> ids = lists[rarest];
+    for (int i = 0; i < lists.size() && !ids.isEmpty(); ++i) {
+        if (i != rarest)
+            ids = intersect(ids, lists[i]);
+    }
+
+    QList<Appointment> result;
+    foreach (int id, ids)
+        result.append(*_events.constFind(id));
+    locker.unlock();
+
+    std::stable_sort(result.begin(), result.end(), startsEarlier);
+    return result.mid(0, limit);
+}
+
+int SearchIndex::size() {
+    QReadLocker locker(&_lock);
+    return _events.size();
+}
+
+QStringList SearchIndex::tokenize(const QString& text) {
+    QStringList words;
+    int start = -1;
+    for (int i = 0; i <= text.size(); ++i) {
+        bool inWord = i < text.size() && text[i].isLetterOrNumber();
+        if (inWord && start < 0) {
+            start = i;
+        } else if (!inWord && start >= 0) {
+            words.append(text.mid(start, i - start).toLower());
+            start = -1;
+        }
+    }
+    return words;
+}
+
+QVector<int> SearchIndex::postingsFor(const QString& word, bool prefix) const {
+    if (!prefix)
+        return _postings.value(word);
+
+    // Merge the posting lists of all words in the prefix range
+    QVector<int> merged;
+    QMap<QString, QVector<int> >::const_iterator it = _postings.lowerBound(word);
+    for (; it != _postings.constEnd() && it.key().startsWith(word); ++it)
+        merged += *it;
+
+    std::sort(merged.begin(), merged.end());
+    merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+    return merged;
+}
+
+void SearchIndex::addPostings(int id, const Appointment& apt) {
+    QStringList words = tokenize(apt.summary());
+    words.removeDuplicates();
+    foreach (const QString& word, words)
+        _postings[word].append(id);
+}
+
+void SearchIndex::removePostings(int id, const Appointment& apt) {
+    QStringList words = tokenize(apt.summary());
+    words.removeDuplicates();
+    foreach (const QString& word, words) {
+        QMap<QString, QVector<int> >::iterator it = _postings.find(word);
+        if (it == _postings.end())
+            continue;
+
+        QVector<int>::iterator pos = std::lower_bound(it->begin(), it->end(), id);
+        if (pos != it->end() && *pos == id)
+            it->erase(pos);
+        if (it->isEmpty())
+            _postings.erase(it);
+    }
+}
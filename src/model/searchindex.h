@@ -0,0 +1,87 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include "appointment.h"
+#include <QMap>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <QStringList>
+#include <QReadWriteLock>
+
+/**
+  * Inverted index over the appointment summaries of one calendar. Summaries are
+  * split into lowercase words; every word maps to the sorted list of IDs of the
+  * appointments it occurs in. The words are kept in order, so a prefix query is a
+  * range of the dictionary.
+  *
+  * The index is never rebuilt. Every parse produces a Diff against the previous
+  * timeline, and apply() only touches the posting lists of the appointments that
+  * came or went. IDs are handed out in increasing order, so adding an appointment
+  * appends to its posting lists.
+  * \author Pieter De Decker
+  */
+class SearchIndex
+{
+public:
+    SearchIndex();
+
+    /** Appointments that appeared in and disappeared from a timeline. */
+    struct Diff {
+        QList<Appointment> added;
+        QList<Appointment> removed;
+
+        bool isEmpty() const { return added.isEmpty() && removed.isEmpty(); }
+    };
+
+    /** [THREAD-SAFE] Compares two timelines and returns what changed. Appointments
+      * are matched on start, end and summary; duplicates are counted. */
+    static Diff diff(const QList<Appointment>& oldTimeline, const QList<Appointment>& newTimeline);
+
+    /** [THREAD-SAFE] Applies a diff produced against the timeline the index holds. */
+    void apply(const Diff& diff);
+
+    /** [THREAD-SAFE] Returns the appointments whose summary contains all terms of
+      * 'query', sorted on start time. A term ending in '*' matches every word that
+      * starts with it. At most 'limit' appointments are returned. */
+    QList<Appointment> search(const QString& query, int limit);
+
+    /** [THREAD-SAFE] Number of indexed appointments. */
+    int size();
+
+    /** Splits text into lowercase words, the way summaries are indexed. */
+    static QStringList tokenize(const QString& text);
+private:
+    /** Identity of an appointment for diffing and removal. */
+    struct Key {
+        Key() {}
+        Key(const Appointment& apt) : start(apt.start().toMSecsSinceEpoch()),
+            end(apt.end().toMSecsSinceEpoch()), summary(apt.summary()) {}
+
+        bool operator==(const Key& other) const {
+            return start == other.start && end == other.end && summary == other.summary;
+        }
+
+        qint64 start;
+        qint64 end;
+        QString summary;
+    };
+    friend uint qHash(const Key& key);
+
+    /** Sorted IDs of the appointments containing 'word', or a word starting with it
+      * if 'prefix' is set. The caller holds _lock. */
+    QVector<int> postingsFor(const QString& word, bool prefix) const;
+
+    /** Adds or removes one ID from the posting lists of 'apt'. */
+    void addPostings(int id, const Appointment& apt);
+    void removePostings(int id, const Appointment& apt);
+
+    QReadWriteLock _lock;
+    int _nextId;
+    QHash<int, Appointment> _events;
+    QMultiHash<Key, int> _ids;
+    QMap<QString, QVector<int> > _postings;
+};
+
+#endif // SEARCHINDEX_H
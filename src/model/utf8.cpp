@@ -0,0 +1,64 @@
+#include "utf8.h"
+
+QString Utf8::decode(const char* data, int size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+
+    // Fast path: ASCII is identical in Latin-1 and UTF-8
+    int firstHigh = 0;
+    while (firstHigh < size && bytes[firstHigh] < 0x80)
+        ++firstHigh;
+    if (firstHigh == size)
+        return QString::fromLatin1(data, size);
+
+    // The ASCII prefix has already been checked
+    if (isValid(bytes + firstHigh, size - firstHigh))
+        return QString::fromUtf8(data, size);
+    else
+        return QString::fromLatin1(data, size);
+}
+
+bool Utf8::isValid(const unsigned char* data, int size) {
+    int i = 0;
+    while (i < size) {
+        unsigned char lead = data[i];
+
+        // Single byte
+        if (lead < 0x80) {
+            ++i;
+            continue;
+        }
+
+        // Determine the sequence length and the valid range of the second byte,
+        // which rules out overlong forms, surrogates and values above U+10FFFF
+        int length;
+        unsigned char low = 0x80, high = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            length = 2;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            length = 3;
+            if (lead == 0xE0)
+                low = 0xA0;
+            else if (lead == 0xED)
+                high = 0x9F;
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            length = 4;
+            if (lead == 0xF0)
+                low = 0x90;
+            else if (lead == 0xF4)
+                high = 0x8F;
+        } else {
+            return false;
+        }
+
+        if (i + length > size || data[i + 1] < low || data[i + 1] > high)
+            return false;
+        for (int j = 2; j < length; ++j) {
+            if ((data[i + j] & 0xC0) != 0x80)
+                return false;
+        }
+
+        i += length;
+    }
+
+    return true;
+}
@@ -0,0 +1,28 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <QString>
+#include <QByteArray>
+
+/**
+  * Decodes UTF-8 byte ranges into QStrings. Calendar data is mostly plain ASCII,
+  * which takes a fast path that skips the UTF-8 codec. Input that isn't valid
+  * UTF-8 is decoded as Latin-1 instead of being mangled into replacement
+  * characters, since some servers still serve ICS files in legacy encodings.
+  * \author Pieter De Decker
+  */
+class Utf8
+{
+public:
+    /** Decodes 'size' bytes starting at 'data'. */
+    static QString decode(const char* data, int size);
+
+    /** Decodes a complete byte array. */
+    static QString decode(const QByteArray& data) { return decode(data.constData(), data.size()); }
+
+    /** Returns true if the byte range is well-formed UTF-8 (no overlong forms,
+      * surrogates or code points beyond U+10FFFF). */
+    static bool isValid(const unsigned char* data, int size);
+};
+
+#endif // UTF8_H
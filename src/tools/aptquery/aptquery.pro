@@ -0,0 +1,11 @@
+# Queries a running AptNotifier or aptnotifierd over its local socket.
+
+QT       += core network
+QT       -= gui
+
+TARGET = aptquery
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += main.cpp
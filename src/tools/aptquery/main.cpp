@@ -0,0 +1,86 @@
+#include <cstdio>
+#include <QByteArray>
+#include <QStringList>
+#include <QLocalSocket>
+#include <QCoreApplication>
+
+static const int TIMEOUT = 2000;
+
+static int usage() {
+    fprintf(stderr, "Usage: aptquery [--server <name>] next <n>\n"
+                    "       aptquery [--server <name>] window <from> <to>\n"
+                    "       aptquery [--server <name>] search <term> [<term>...]\n"
+                    "       aptquery [--server <name>] status\n"
+                    "       aptquery [--server <name>] locks\n"
+                    "       aptquery [--server <name>] fetches\n"
+                    "Times are ISO 8601, e.g. 2012-03-01T09:00:00\n");
+    return 2;
+}
+
+/** The server's default name, "aptnotifier-<user>"; see QueryServer::defaultName. */
+static QString defaultServer() {
+    QString user = QString::fromLocal8Bit(qgetenv("USER"));
+    if (user.isEmpty())
+        user = QString::fromLocal8Bit(qgetenv("USERNAME"));
+    return user.isEmpty() ? QString("aptnotifier") : "aptnotifier-" + user;
+}
+
+/** Reads one line from 'socket', waiting for it if needed. Returns false on timeout. */
+static bool readLine(QLocalSocket& socket, QByteArray& line) {
+    while (!socket.canReadLine()) {
+        if (!socket.waitForReadyRead(TIMEOUT))
+            return false;
+    }
+    line = socket.readLine();
+    line.chop(1);
+    return true;
+}
+
+/** Sends a single request to the query server and prints the response lines.
+  * Exits with 0 on success, 1 if the server reported an error and 2 if it
+  * couldn't be reached. */
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QStringList args = QCoreApplication::arguments();
+    args.removeFirst();
+
+    QString server = defaultServer();
+    if (args.size() >= 2 && args.first() == "--server") {
+        args.removeFirst();
+        server = args.takeFirst();
+    }
+    if (args.isEmpty())
+        return usage();
+
+    QLocalSocket socket;
+    socket.connectToServer(server);
+    if (!socket.waitForConnected(TIMEOUT)) {
+        fprintf(stderr, "Can't connect to %s: %s\n", qPrintable(server), qPrintable(socket.errorString()));
+        return 2;
+    }
+
+    socket.write(args.join(" ").toUtf8() + '\n');
+    socket.flush();
+
+    QByteArray line;
+    if (!readLine(socket, line)) {
+        fprintf(stderr, "No response from %s\n", qPrintable(server));
+        return 2;
+    }
+    if (!line.startsWith("OK ")) {
+        fprintf(stderr, "%s\n", line.constData());
+        return 1;
+    }
+
+    int count = line.mid(3).toInt();
+    for (int i = 0; i < count; ++i) {
+        if (!readLine(socket, line)) {
+            fprintf(stderr, "Response from %s was cut off\n", qPrintable(server));
+            return 2;
+        }
+        printf("%s\n", line.constData());
+    }
+
+    return 0;
+}
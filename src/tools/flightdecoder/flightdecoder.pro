@@ -0,0 +1,19 @@
+# Decodes the flight recorder file written by AptNotifier.
+
+QT       += core
+QT       -= gui
+
+TARGET = flightdecoder
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../model/flightrecorder.cpp \
+    ../../model/logger.cpp
+
+HEADERS += \
+    ../../model/flightrecorder.h \
+    ../../model/logger.h
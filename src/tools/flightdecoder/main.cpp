@@ -0,0 +1,117 @@
+#include "model/flightrecorder.h"
+#include <QMap>
+#include <QFile>
+#include <cstdio>
+#include <cstring>
+#include <QDateTime>
+#include <QStringList>
+#include <QCoreApplication>
+
+/** Returns the label stored at 'index', or a placeholder if there is none. */
+static QString labelAt(const char* labels, const FlightRecorder::Header* header, int index) {
+    if (index < 0 || index >= int(header->labelCount))
+        return "(unknown)";
+
+    const char* label = labels + index*header->labelSize;
+    return QString::fromLatin1(label, qstrnlen(label, header->labelSize));
+}
+
+/** Spells out the values of an event, based on its type. */
+static QString describe(const FlightRecorder::Record& rec, const char* labels, const FlightRecorder::Header* header) {
+    static const char* statusNames[] = { "NotLoaded", "Online", "Offline" };
+    QString subject = "0x" + QString::number(rec.subject, 16);
+
+    switch (rec.type) {
+    case FlightRecorder::Started:
+        return QString("capacity=%1").arg(rec.a);
+    case FlightRecorder::RefreshStarted:
+        return QString("calendar=%1 manual=%2").arg(subject).arg(rec.a);
+    case FlightRecorder::RefreshFinished:
+        return QString("calendar=%1 status=%2 ms=%3").arg(subject)
+                .arg(0 <= rec.a && rec.a < 3 ? statusNames[rec.a] : "?").arg(rec.b);
+    case FlightRecorder::ParseFinished:
+        return QString("calendar=%1 appointments=%2 us=%3").arg(subject)
+                .arg(rec.a < 0 ? QString("unchanged") : QString::number(rec.a)).arg(rec.b);
+    case FlightRecorder::LockWaited:
+        return QString("calendar=%1 wait_us=%2 site='%3'").arg(subject).arg(rec.a)
+                .arg(labelAt(labels, header, rec.b));
+    case FlightRecorder::TimerFired:
+        return QString("calendar=%1 timer=%2").arg(subject)
+                .arg(rec.a == FlightRecorder::RefreshTimer ? "refresh" : "notification");
+    case FlightRecorder::ToastQueued:
+        return QString("calendar=%1 appointments=%2").arg(subject).arg(rec.a);
+    case FlightRecorder::FatalSignal:
+        return QString("signal=%1").arg(rec.a);
+    default:
+        return QString("subject=%1 a=%2 b=%3").arg(subject).arg(rec.a).arg(rec.b);
+    }
+}
+
+/** Usage: flightdecoder [--last N] [FILE]
+  * Prints the events in FILE (flightrecorder.bin by default) from oldest to newest. */
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QString path = FlightRecorder::DEFAULTPATH;
+    int last = -1;
+
+    QStringList args = QCoreApplication::arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        if (args[i] == "--last" && i + 1 < args.size())
+            last = args[++i].toInt();
+        else
+            path = args[i];
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "Couldn't open %s\n", qPrintable(path));
+        return 1;
+    }
+
+    // Map read-only; the file may be large
+    const uchar* base = file.map(0, file.size());
+    const FlightRecorder::Header* header = reinterpret_cast<const FlightRecorder::Header*>(base);
+    if (!base || file.size() < qint64(sizeof(FlightRecorder::Header))
+            || memcmp(header->magic, FlightRecorder::MAGIC, sizeof(header->magic)) != 0) {
+        fprintf(stderr, "%s is not a flight recorder file\n", qPrintable(path));
+        return 1;
+    }
+    if (header->version != FlightRecorder::VERSION || header->recordSize != sizeof(FlightRecorder::Record)) {
+        fprintf(stderr, "%s was written by an incompatible version\n", qPrintable(path));
+        return 1;
+    }
+
+    const char* labels = reinterpret_cast<const char*>(base + sizeof(FlightRecorder::Header));
+    qint64 recordsOffset = sizeof(FlightRecorder::Header) + qint64(header->labelCount)*header->labelSize;
+    if (file.size() < recordsOffset + qint64(header->capacity)*header->recordSize) {
+        fprintf(stderr, "%s is truncated\n", qPrintable(path));
+        return 1;
+    }
+    const FlightRecorder::Record* records = reinterpret_cast<const FlightRecorder::Record*>(base + recordsOffset);
+
+    // Completed slots have a non-zero sequence; sort them back into order
+    QMap<quint32, const FlightRecorder::Record*> ordered;
+    for (quint32 i = 0; i < header->capacity; ++i) {
+        if (records[i].sequence != 0)
+            ordered.insert(records[i].sequence, &records[i]);
+    }
+
+    QDateTime started = QDateTime::fromMSecsSinceEpoch(header->startMsecs);
+    printf("%s: pid %lld, started %s, %u slots, %d events\n", qPrintable(path), (long long)header->processId,
+           qPrintable(started.toString("yyyy-MM-dd hh:mm:ss.zzz")), header->capacity, ordered.size());
+
+    // A ring that ends without Stopped belongs to a process that didn't exit cleanly
+    if (!ordered.isEmpty() && ordered.last()->type != FlightRecorder::Stopped)
+        printf("warning: no Stopped event, the process didn't shut down cleanly\n");
+
+    int skip = (last >= 0 && last < ordered.size()) ? ordered.size() - last : 0;
+    QMap<quint32, const FlightRecorder::Record*>::const_iterator it = ordered.constBegin() + skip;
+    for (; it != ordered.constEnd(); ++it) {
+        const FlightRecorder::Record& rec = **it;
+        printf("%10u %+14.6f t%04x %-16s %s\n", rec.sequence, rec.timestamp/1000000.0, rec.thread,
+               FlightRecorder::typeName(rec.type), qPrintable(describe(rec, labels, header)));
+    }
+
+    return 0;
+}
@@ -0,0 +1,4 @@
+# Support tools. See the README for how to use them.
+
+TEMPLATE = subdirs
+SUBDIRS = flightdecoder aptquery
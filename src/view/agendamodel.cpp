@@ -0,0 +1,135 @@
+#include "agendamodel.h"
+
+#include "model/calendar.h"
+#include "model/calendardb.h"
+#include "view/pixmapcache.h"
+#include <cassert>
+#include <algorithm>
+
+LogCategory AgendaModel::CLASSNAME("AgendaModel");
+const int AgendaModel::ICONSIZE = 14;
+const int AgendaModel::FETCHBATCH = 200;
+const int AgendaModel::REBUILDDELAY = 250;
+
+AgendaModel::AgendaModel(CalendarDB* calDB, QObject* parent)
+    : QAbstractListModel(parent)
+{
+    assert(calDB);
+    _calDB = calDB;
+    _fetched = 0;
+    connect(_calDB, SIGNAL(newCalendarAdded(int)), this, SLOT(addCalendar(int)));
+    connect(_calDB, SIGNAL(removingCalendar(int)), this, SLOT(removeCalendar(int)));
+
+    _rebuildTimer.setSingleShot(true);
+    _rebuildTimer.setInterval(REBUILDDELAY);
+    connect(&_rebuildTimer, SIGNAL(timeout()), this, SLOT(rebuild()));
+}
+
+int AgendaModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : _fetched;
+}
+
+bool AgendaModel::canFetchMore(const QModelIndex& parent) const {
+    return !parent.isValid() && _fetched < _entries.size();
+}
+
+void AgendaModel::fetchMore(const QModelIndex& parent) {
+    if (parent.isValid())
+        return;
+
+    int count = std::min(FETCHBATCH, _entries.size() - _fetched);
+    if (count <= 0)
+        return;
+    beginInsertRows(QModelIndex(), _fetched, _fetched + count - 1);
+    _fetched += count;
+    endInsertRows();
+}
+
+QVariant AgendaModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= _fetched)
+        return QVariant();
+
+    // Only called for rows in the viewport, so formatting happens here
+    const Entry& entry = _entries.at(index.row());
+    const Appointment& apt = _timelines.constFind(entry.calendarId)->at(entry.index);
+    switch (role) {
+    case Qt::DisplayRole: {
+        QString when = apt.isDayWide() ? apt.start().toString("ddd d MMM") + "  all day"
+                                       : apt.start().toString("ddd d MMM  hh:mm");
+        return when + "  " + apt.summary();
+    }
+    case Qt::DecorationRole: {
+        Calendar* cal = _calDB->calendar(entry.calendarId);
+        if (!cal)
+            return QVariant();
+        return PixmapCache::instance()->calendarIcon(cal, ICONSIZE, 1, QColor(25, 25, 25));
+    }
+    case Qt::ToolTipRole:
+        return apt.summary() + "\n" + apt.timeString();
+    default:
+        return QVariant();
+    }
+}
+
+void AgendaModel::addCalendar(int id) {
+    Calendar* cal = _calDB->calendar(id);
+    assert(cal);
+    connect(cal, SIGNAL(timelineChanged(int)), this, SLOT(markChanged(int)));
+    markChanged(id);
+}
+
+void AgendaModel::removeCalendar(int id) {
+    // Entries refer to the timeline, so it stays until the next rebuild
+    markChanged(id);
+}
+
+void AgendaModel::markChanged(int id) {
+    _changed.insert(id);
+    if (!_rebuildTimer.isActive())
+        _rebuildTimer.start();
+}
+
+void AgendaModel::refresh() {
+    _rebuildTimer.stop();
+    rebuild();
+}
+
+void AgendaModel::rebuild() {
+    // Calendars that are gone lose their timeline, the others get their latest one
+    foreach (int id, _changed) {
+        Calendar* cal = _calDB->calendar(id);
+        if (cal)
+            _timelines.insert(id, cal->timeline());
+        else
+            _timelines.remove(id);
+    }
+    _changed.clear();
+
+    // Index everything that hasn't ended yet
+    QDateTime now = QDateTime::currentDateTime();
+    QVector<Entry> entries;
+    for (QHash<int, QList<Appointment> >::const_iterator it = _timelines.constBegin();
+         it != _timelines.constEnd(); ++it) {
+        const QList<Appointment>& timeline = *it;
+        for (int i = 0; i < timeline.size(); ++i) {
+            const Appointment& apt = timeline.at(i);
+            if (apt.end() <= now)
+                continue;
+
+            Entry entry;
+            entry.start = apt.start().toMSecsSinceEpoch();
+            entry.calendarId = it.key();
+            entry.index = i;
+            entries.append(entry);
+        }
+    }
+    std::sort(entries.begin(), entries.end());
+
+    // Keep as many rows fetched as before, so the view doesn't jump back
+    beginResetModel();
+    _entries = entries;
+    _fetched = std::min(_entries.size(), std::max(_fetched, FETCHBATCH));
+    endResetModel();
+    LOG_DEBUG(CLASSNAME, this, LogMessage("Agenda holds %1 appointments from %2 calendars")
+              .arg(_entries.size()).arg(_timelines.size()));
+}
@@ -0,0 +1,79 @@
+#ifndef AGENDAMODEL_H
+#define AGENDAMODEL_H
+
+#include "model/logger.h"
+#include "model/appointment.h"
+#include <QSet>
+#include <QHash>
+#include <QList>
+#include <QTimer>
+#include <QVector>
+#include <QAbstractListModel>
+class CalendarDB;
+
+/**
+  * List model merging the appointments of all calendars that haven't ended yet,
+  * sorted on start time. Rows only refer to the calendars' shared timelines, so
+  * tens of thousands of them cost a few bytes each. Rows are handed to the view
+  * in batches of FETCHBATCH as it scrolls (canFetchMore/fetchMore), and timeline
+  * changes are collected for REBUILDDELAY ms before the merged index is rebuilt.
+  * Only to be used from the GUI thread.
+  * \author Pieter De Decker
+  */
+class AgendaModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    AgendaModel(CalendarDB* calDB, QObject* parent = 0);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+    bool canFetchMore(const QModelIndex& parent) const;
+    void fetchMore(const QModelIndex& parent);
+
+    /** Height of the calendar icons in pixels. */
+    static const int ICONSIZE;
+
+    static const int FETCHBATCH;
+    static const int REBUILDDELAY;
+public slots:
+    /** Drops appointments that ended since the last rebuild. */
+    void refresh();
+private:
+    static LogCategory CLASSNAME;
+
+    /** Position of an appointment in one of the timelines. */
+    struct Entry {
+        qint64 start;
+        int calendarId;
+        int index;
+
+        bool operator<(const Entry& other) const {
+            return start < other.start || (start == other.start && calendarId < other.calendarId);
+        }
+    };
+
+    CalendarDB* _calDB;
+
+    /** Timelines of all calendars, by calendar ID. */
+    QHash<int, QList<Appointment> > _timelines;
+
+    /** Calendars whose timeline changed since the last rebuild. */
+    QSet<int> _changed;
+    QTimer _rebuildTimer;
+
+    /** Merged index, and how many of its rows the view knows about. */
+    QVector<Entry> _entries;
+    int _fetched;
+private slots:
+    void addCalendar(int id);
+    void removeCalendar(int id);
+
+    /** Schedules a rebuild for a calendar's new timeline. */
+    void markChanged(int id);
+
+    /** Reads the changed timelines and rebuilds the merged index. */
+    void rebuild();
+};
+
+#endif // AGENDAMODEL_H
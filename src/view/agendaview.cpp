@@ -0,0 +1,31 @@
+#include "agendaview.h"
+
+#include <QCoreApplication>
+
+AgendaView::AgendaView(CalendarDB* calDB, QWidget* parent)
+    : QWidget(parent), _model(calDB)
+{
+    setupGUI();
+}
+
+void AgendaView::setupGUI() {
+    setWindowTitle(QCoreApplication::applicationName() + " - Agenda");
+    resize(420, 520);
+
+    // Rows all have the same height, so the view can skip measuring them
+    _list.setModel(&_model);
+    _list.setUniformItemSizes(true);
+    _list.setLayoutMode(QListView::Batched);
+    _list.setBatchSize(AgendaModel::FETCHBATCH);
+    _list.setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    _list.setEditTriggers(QAbstractItemView::NoEditTriggers);
+    _list.setIconSize(QSize(AgendaModel::ICONSIZE, AgendaModel::ICONSIZE));
+
+    _mainLayout.addWidget(&_list);
+    setLayout(&_mainLayout);
+}
+
+void AgendaView::showEvent(QShowEvent* event) {
+    _model.refresh();
+    QWidget::showEvent(event);
+}
@@ -0,0 +1,35 @@
+#ifndef AGENDAVIEW_H
+#define AGENDAVIEW_H
+
+#include "view/agendamodel.h"
+#include <QWidget>
+#include <QListView>
+#include <QVBoxLayout>
+class CalendarDB;
+
+/**
+  * Window listing the upcoming appointments of all calendars. The list view only
+  * lays out and paints the rows in its viewport, and asks the model for more rows
+  * as the user scrolls down.
+  * \author Pieter De Decker
+  */
+class AgendaView : public QWidget
+{
+    Q_OBJECT
+public:
+    AgendaView(CalendarDB* calDB, QWidget* parent = 0);
+protected:
+    /** Drops appointments that ended while the window was hidden. */
+    void showEvent(QShowEvent* event);
+private:
+    /** Configures all controls and layouts. */
+    void setupGUI();
+
+    AgendaModel _model;
+
+    // Layout and controls
+    QVBoxLayout _mainLayout;
+    QListView _list;
+};
+
+#endif // AGENDAVIEW_H
@@ -2,24 +2,24 @@
 
 #include "inputbox.h"
 #include "model/logger.h"
+#include "model/lockprofiler.h"
 #include "model/calendardb.h"
 #include "model/appointment.h"
 #include "view/toaster/toaster.h"
 #include <cassert>
 #include <QMetaType>
 #include <QMessageBox>
-#include <QListWidgetItem>
+#include <QItemSelectionModel>
 #include <QtConcurrentRun>
 #include <QCoreApplication>
 
-const char* CalendarDBView::CLASSNAME = "CalendarDBView";
+LogCategory CalendarDBView::CLASSNAME("CalendarDBView");
 
 CalendarDBView::CalendarDBView(CalendarDB *calDB, QWidget *parent)
-    : QMainWindow(parent)
+    : QMainWindow(parent), _calModel(calDB), _agenda(calDB), _tm(&calDB->calendars())
 {
     assert(calDB);
     _calDB = calDB;
-    _allCalsOnline = true;
     setupGUI();
 
     // Load the calendar list from a file
@@ -31,8 +31,9 @@ CalendarDBView::~CalendarDBView()
 
 void CalendarDBView::setupGUI() {
     assert(_calDB);
-    connect(_calDB, SIGNAL(newCalendarAdded(Calendar*)), this, SLOT(registerCalendar(Calendar*)));
-    connect(_calDB, SIGNAL(removingCalendar(Calendar*)), this, SLOT(unregisterCalendar(Calendar*)));
+    connect(_calDB, SIGNAL(newCalendarAdded(int)), this, SLOT(registerCalendar(int)));
+    connect(_calDB, SIGNAL(notificationsDue(QList<Notification>)), this, SLOT(processNotifications(QList<Notification>)));
+    connect(&_calModel, SIGNAL(allOnlineChanged(bool)), this, SLOT(updateOnlineStatus(bool)));
     setWindowTitle(QCoreApplication::applicationName() + " " + QCoreApplication::applicationVersion());
 
     // Set up button group
@@ -48,8 +49,11 @@ void CalendarDBView::setupGUI() {
     _buttonContainer.addWidget(&_btnHide);
 
     // Set up main layout
+    _calList.setModel(&_calModel);
+    _calList.setUniformItemSizes(true);
+    _calList.setIconSize(QSize(CalendarListModel::ICONSIZE, CalendarListModel::ICONSIZE));
     _mainLayout.addWidget(&_calList);
-    connect(&_calList, SIGNAL(itemSelectionChanged()), this, SLOT(updateBtnRemoveState()));
+    connect(_calList.selectionModel(), SIGNAL(selectionChanged(QItemSelection,QItemSelection)), this, SLOT(updateBtnRemoveState()));
     _mainLayout.addLayout(&_buttonContainer);
     _centralWidget.setLayout(&_mainLayout);
     setCentralWidget(&_centralWidget);
@@ -59,176 +63,130 @@ void CalendarDBView::setupGUI() {
     _trayIcon.setToolTip(QCoreApplication::applicationName() + " " + QCoreApplication::applicationVersion());
     _trayIcon.show();
     QAction* showWindow = _trayMenu.addAction("Show window");
+    QAction* showAgenda = _trayMenu.addAction("Show agenda");
     QAction* updateAll = _trayMenu.addAction("Update all");
+    QAction* dumpLocks = _trayMenu.addAction("Dump lock profile");
     QAction* quitAct = _trayMenu.addAction("Quit");
     connect(showWindow, SIGNAL(triggered()), this, SLOT(show()));
+    connect(showAgenda, SIGNAL(triggered()), this, SLOT(showAgenda()));
     connect(updateAll, SIGNAL(triggered()), this, SLOT(updateCalendars()));
+    connect(dumpLocks, SIGNAL(triggered()), this, SLOT(dumpLockProfile()));
     connect(quitAct, SIGNAL(triggered()), this, SLOT(close()));
     _trayIcon.setContextMenu(&_trayMenu);
 }
 
-void CalendarDBView::updateCalendarLabel(Calendar *cal)
+void CalendarDBView::updateOnlineStatus(bool allOnline)
 {
-    QString statusName;
-    switch (cal->status()) {
-    default:
-    case Calendar::NotLoaded:
-        statusName = "not loaded";
-        break;
-    case Calendar::Online:
-        statusName = "online";
-        break;
-    case Calendar::Offline:
-        statusName = "offline";
-        break;
-    }
-
-    QMap<Calendar*, QListWidgetItem*>::iterator it = _calItems.find(cal);
-    assert(it != _calItems.end());
-    it.value()->setText(cal->name() + " (" + statusName + ")");
-}
+    LOG_DEBUG(CLASSNAME, NULL, LogMessage("All calendars online: %1").arg(allOnline));
 
-void CalendarDBView::refreshCalUpdateStatus()
-{
-    _calsLock.lock();
-    Logger::instance()->add(CLASSNAME, "Refreshing calendar updates statuses...");
-
-    // Are all known calendars now online?
-    _allCalsOnline = true;
-    for (QMap<Calendar*, QListWidgetItem*>::iterator it = _calItems.begin();
-         it != _calItems.end() && _allCalsOnline; ++it) {
-        Calendar* curCal = it.key();
-        if (curCal->status() != Calendar::Online) {
-            _allCalsOnline = false;
-            setWindowIcon(QIcon(":/general/appointmentgrey.png"));
-            _trayIcon.setToolTip(QCoreApplication::applicationName() + " -- Some calendars are offline.");
-            _trayIcon.setIcon(QIcon(":/general/appointmentgrey.png"));
-        }
-    }
-
-    // All found calendars are online, we're good to go.
-    if (_allCalsOnline) {
+    if (allOnline) {
         setWindowIcon(QIcon(":/general/appointment.png"));
         _trayIcon.setToolTip(QCoreApplication::applicationName());
         _trayIcon.setIcon(QIcon(":/general/appointment.png"));
+    } else {
+        setWindowIcon(QIcon(":/general/appointmentgrey.png"));
+        _trayIcon.setToolTip(QCoreApplication::applicationName() + " -- Some calendars are offline.");
+        _trayIcon.setIcon(QIcon(":/general/appointmentgrey.png"));
     }
-
-    _calsLock.unlock();
-}
-
-void CalendarDBView::registerCalendar(Calendar* cal)
-{
-    connect(cal, SIGNAL(nameChanged(Calendar*)), this, SLOT(processCalendarNameChange(Calendar*)));
-    connect(cal, SIGNAL(newOngoingAppointments(Calendar*,QList<Appointment>)), this, SLOT(processNewOngoingAptEvents(Calendar*,QList<Appointment>)));
-    connect(cal, SIGNAL(newReminders(Calendar*,QList<Appointment>)), this, SLOT(processReminders(Calendar*,QList<Appointment>)));
-    connect(cal, SIGNAL(formatNotRecognized(Calendar*)), this, SLOT(showInvalidCalendarFormatError(Calendar*)));
-    connect(cal, SIGNAL(statusChanged(Calendar*)), this, SLOT(processCalendarStatusChange(Calendar*)));
-
-    // Create new widget item. The list widget takes ownership, so no need to delete.
-    _calsLock.lock();
-    Logger::instance()->add(CLASSNAME, "Registering calendar with URL " + cal->url().toString() + "...");
-    QImage calImg = cal->image().scaledToHeight(_calList.height());
-    Calendar::drawBorder(calImg, 1, QColor(0, 0, 0));
-    QListWidgetItem* newItem = new QListWidgetItem(QIcon(QPixmap::fromImage(calImg)), cal->name());
-    _calList.addItem(newItem);
-    _calItems[cal] = newItem;
-    _widItems[newItem] = cal;
-    _calsLock.unlock();
-
-    // Refresh the global calendar update status.
-    refreshCalUpdateStatus();
 }
 
-void CalendarDBView::processCalendarNameChange(Calendar* cal)
+void CalendarDBView::registerCalendar(int id)
 {
-    // Thread safety: this slot will not be executing for two
-    // objects simultaneously. See connect() docs for details.
-
-    // Only an update of the list widget is needed
-    updateCalendarLabel(cal);
+    // The list model takes care of names and statuses, CalendarDB batches notifications
+    Calendar* cal = _calDB->calendar(id);
+    assert(cal);
+    LOG_DEBUG(CLASSNAME, NULL, LogMessage("Registering calendar with URL %1...").arg(cal->url()));
+    connect(cal, SIGNAL(formatNotRecognized(int)), this, SLOT(showInvalidCalendarFormatError(int)));
 }
 
-void CalendarDBView::processCalendarStatusChange(Calendar *cal)
-{
-    // Thread safety: this slot will not be executing for two
-    // objects simultaneously. See connect() docs for details.
-
-    // Update the list widget
-    updateCalendarLabel(cal);
-
-    // Refresh the global calendar update status
-    refreshCalUpdateStatus();
-}
-
-void CalendarDBView::unregisterCalendar(Calendar* cal)
-{
-    _calsLock.lock();
-    Logger::instance()->add(CLASSNAME, "Unregistering calendar " + cal->name() + "...");
-
-    // Search for the associated QListWidgetItem and associated iterators
-    QMap<Calendar*, QListWidgetItem*>::iterator calIt = _calItems.find(cal);
-    assert(calIt != _calItems.end());
-    QListWidgetItem* widgetItem = *calIt;
-    QMap<QListWidgetItem*, Calendar*>::iterator widIt = _widItems.find(widgetItem);
-    assert(widIt != _widItems.end());
-
-    // Remove it from the list widget
-    _calList.removeItemWidget(widgetItem);
-    delete widgetItem;      // Deletion needed because _calList lost ownership
-
-    // Remove the calendar from the Calendar/QListWidgetItem dictionaries
-    _calItems.erase(calIt);
-    _widItems.erase(widIt);
-
-    _calsLock.unlock();
-
-    // Refresh the global calendar update status.
-    refreshCalUpdateStatus();
+void CalendarDBView::processNotifications(const QList<Notification>& batch) {
+    queueNotifications(batch, Notification::Ongoing);
+    queueNotifications(batch, Notification::Reminder);
 }
 
-void CalendarDBView::processNewOngoingAptEvents(Calendar *cal, const QList<Appointment>& list) {
-    _tm.addToQueue(cal, "Now in progress", list);
-}
+void CalendarDBView::queueNotifications(const QList<Notification>& batch, Notification::Kind kind) {
+    QString title = (kind == Notification::Ongoing) ? "Now in progress" : "Event reminder";
+    int count = 0;
+    foreach (const Notification& n, batch) {
+        if (n.kind != kind)
+            continue;
+
+        // Escalated appointments go first and always get a slide of their own
+        if (n.apt.priority() == Appointment::Escalated) {
+            if (Calendar* cal = _calDB->calendar(n.calendarId))
+                _tm.addToQueue(cal, "Important: " + title, QList<Appointment>() << n.apt);
+        } else {
+            ++count;
+        }
+    }
+    if (count == 0)
+        return;
+
+    // Too many to go through one by one
+    if (count >= _calDB->summaryThreshold()) {
+        QString summary = (kind == Notification::Ongoing) ? "%1 events starting now" : "%1 events coming up";
+        _tm.addSummaryToQueue(title, summary.arg(count));
+        return;
+    }
 
-void CalendarDBView::processReminders(Calendar *cal, const QList<Appointment>& list) {
-    _tm.addToQueue(cal, "Event reminder", list);
+    // The notifications of a calendar are adjacent in the batch: one bundle per calendar
+    QList<Appointment> list;
+    int calendarId = -1;
+    foreach (const Notification& n, batch) {
+        if (n.kind != kind || n.apt.priority() == Appointment::Escalated)
+            continue;
+        if (n.calendarId != calendarId && !list.isEmpty()) {
+            if (Calendar* cal = _calDB->calendar(calendarId))
+                _tm.addToQueue(cal, title, list);
+            list.clear();
+        }
+        calendarId = n.calendarId;
+        list.append(n.apt);
+    }
+    if (Calendar* cal = _calDB->calendar(calendarId))
+        _tm.addToQueue(cal, title, list);
 }
 
-void CalendarDBView::showInvalidCalendarFormatError(Calendar* cal) {
-    _trayIcon.showMessage("AptNotifier", "A calendar hosted at " + cal->url().host() + " could not be recognized. You might want to check your connection and verify the address of the calendar.", QSystemTrayIcon::Warning, 5000);
+void CalendarDBView::showInvalidCalendarFormatError(int id) {
+    Calendar* cal = _calDB->calendar(id);
+    if (!cal)
+        return;
+    QString location = cal->url().scheme() == "file" ? cal->url().toLocalFile() : cal->url().host();
+    _trayIcon.showMessage("AptNotifier", "A calendar hosted at " + location + " could not be recognized. You might want to check your connection and verify the address of the calendar.", QSystemTrayIcon::Warning, 5000);
 }
 
 void CalendarDBView::showNewCalendarDialog()
 {
-    InputBox newCalDialog("Enter the URL of the calendar below.", QRegExp("^(http|https)://[a-z0-9]+([-.]{1}[a-z0-9]+)*.[a-z]{2,5}(([0-9]{1,5})?/?.*)$"), this);
+    InputBox newCalDialog("Enter the URL of the calendar below. Local files can be added as file:///path/to/calendar.ics.",
+                          QRegExp("^((http|https)://[a-z0-9]+([-.]{1}[a-z0-9]+)*.[a-z]{2,5}(([0-9]{1,5})?/?.*)|file://.+)$"), this);
     int returnCode = newCalDialog.exec();
 
     // Try to add the calendar if the input is accepted
     if (returnCode == QDialog::Accepted) {
-        _calDB->addCalendar(newCalDialog.inputValue(), _calDB->composeNextColor());
+        if (_calDB->addCalendar(newCalDialog.inputValue(), _calDB->composeNextColor()) < 0)
+            QMessageBox::information(this, "AptNotifier", "This calendar has already been added.");
     }
 }
 
 void CalendarDBView::updateBtnRemoveState() {
     // 'Remove' button can be used if exactly one
     // calendar is selected.
-    if (_calList.selectedItems().count() == 1)
+    if (_calList.selectionModel()->selectedRows().count() == 1)
         _btnRemove.setEnabled(true);
     else
         _btnRemove.setEnabled(false);
 }
 
 void CalendarDBView::removeSelectedCalendars() {
-    QList<QListWidgetItem*> select = _calList.selectedItems();
-
-    // Issue a delete request for all selected items
-    for (QList<QListWidgetItem*>::iterator it = select.begin(); it != select.end(); ++it) {
-        QListWidgetItem* widgetItem = *it;
-
-        assert(_widItems.contains(widgetItem));
-        Calendar* cal = _widItems[widgetItem];
-        _calDB->removeCalendar(cal);
-    }
+    QModelIndexList select = _calList.selectionModel()->selectedRows();
+
+    // Issue a delete request for all selected items. Collect the IDs first:
+    // removing a calendar shifts the rows below it.
+    QList<int> ids;
+    foreach (const QModelIndex& index, select)
+        ids.append(_calModel.idAt(index.row()));
+    foreach (int id, ids)
+        _calDB->removeCalendar(id);
 }
 
 void CalendarDBView::updateCalendars() {
@@ -236,3 +194,16 @@ void CalendarDBView::updateCalendars() {
     assert(_calDB);
     _calDB->updateCalendars();
 }
+
+void CalendarDBView::showAgenda() {
+    _agenda.show();
+    _agenda.raise();
+    _agenda.activateWindow();
+}
+
+void CalendarDBView::dumpLockProfile() {
+    // Asked for explicitly, so skip the level check that would hide it in release builds
+    Logger::instance()->add(Logger::Info, CLASSNAME.name(), NULL,
+                            LogMessage("Lock profile:\n" + LockProfiler::instance()->report()));
+    Logger::instance()->flush();
+}
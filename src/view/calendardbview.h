@@ -3,11 +3,12 @@
 
 #include "model/calendar.h"
 #include "model/appointment.h"
+#include "model/notificationdispatcher.h"
+#include "view/agendaview.h"
+#include "view/calendarlistmodel.h"
 #include "view/toaster/toastmanager.h"
-#include <QMap>
 #include <QMenu>
-#include <QMutex>
-#include <QListWidget>
+#include <QListView>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QPushButton>
@@ -15,7 +16,6 @@
 #include <QtGui/QMainWindow>
 class CalendarDB;
 class AptNotification;
-class QListWidgetItem;
 
 /**
   * Main application window. Also serves as the View counterpart to CalendarDB.
@@ -28,20 +28,17 @@ public:
     CalendarDBView(CalendarDB* calDB, QWidget *parent = 0);
     ~CalendarDBView();
 private:
-    static const char* CLASSNAME;
+    static LogCategory CLASSNAME;
+
+    /** Queues the notifications of one kind from a batch: one by one, or as a
+      * single summary if there are at least CalendarDB::summaryThreshold() of them. */
+    void queueNotifications(const QList<Notification>& batch, Notification::Kind kind);
 
     /** Configures controls and connections in the GUI. */
     void setupGUI();
 
-    /** Updates the name tag of a certain calendar in the list widget. */
-    void updateCalendarLabel(Calendar* cal);
-
-    /** Updates the "all calendars online?" status of the application. */
-    void refreshCalUpdateStatus();
-
     /** The associated CalendarDB in the Model. */
     CalendarDB* _calDB;
-    QMutex _calsLock;
 
     // Controls
     QWidget _centralWidget;
@@ -50,12 +47,11 @@ private:
     QPushButton _btnAdd;
     QPushButton _btnRemove;
     QPushButton _btnHide;
-    QListWidget _calList;
-    QMap<Calendar*, QListWidgetItem*> _calItems;
-    QMap<QListWidgetItem*, Calendar*> _widItems;
+    QListView _calList;
+    CalendarListModel _calModel;
     QSystemTrayIcon _trayIcon;
     QMenu _trayMenu;
-    bool _allCalsOnline;
+    AgendaView _agenda;
 
     // Notification-related data
     ToastManager _tm;
@@ -63,26 +59,19 @@ private slots:
     /** Invokes calendar import dialog to add a new calendar. */
     void showNewCalendarDialog();
 
-    /** Updates view to reflect successfully added calendar. */
-    void registerCalendar(Calendar* cal);
-
-    /** Updates view when the name of a calendar changes. */
-    void processCalendarNameChange(Calendar*);
+    /** Subscribes to the format errors of a successfully added calendar. */
+    void registerCalendar(int id);
 
-    /** Updates view when the status of a calendar changes. */
-    void processCalendarStatusChange(Calendar* cal);
+    /** Updates the window and tray icons when the "all calendars online?" status
+      * of the application changes. */
+    void updateOnlineStatus(bool allOnline);
 
-    /** Updates view when a calendar is removed. */
-    void unregisterCalendar(Calendar* cal);
-
-    /** Triggered when a calendar broadcasts newly ongoing events. */
-    void processNewOngoingAptEvents(Calendar* cal, const QList<Appointment>& list);
-
-    /** Triggered when a calendar broadcasts new reminders. */
-    void processReminders(Calendar* cal, const QList<Appointment>& list);
+    /** Triggered once per notification tick with the ongoing appointments and
+      * reminders of all calendars. */
+    void processNotifications(const QList<Notification>& batch);
 
     /** Shows an Invalid Calendar error for a given calendar. */
-    void showInvalidCalendarFormatError(Calendar* cal);
+    void showInvalidCalendarFormatError(int id);
 
     /** Updates the 'Remove' button state in response to a selection change. */
     void updateBtnRemoveState();
@@ -92,6 +81,12 @@ private slots:
 
     /** Forces a global calendar update. */
     void updateCalendars();
+
+    /** Brings up the agenda window. */
+    void showAgenda();
+
+    /** Writes the lock contention report to the log, regardless of log levels. */
+    void dumpLockProfile();
 };
 
 #endif // CALENDARDBVIEW_H
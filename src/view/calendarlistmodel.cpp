@@ -0,0 +1,165 @@
+#include "calendarlistmodel.h"
+
+#include "model/calendardb.h"
+#include "view/pixmapcache.h"
+#include <cassert>
+#include <algorithm>
+
+LogCategory CalendarListModel::CLASSNAME("CalendarListModel");
+const int CalendarListModel::ICONSIZE = 16;
+const int CalendarListModel::FLUSHINTERVAL = 16;
+
+CalendarListModel::CalendarListModel(CalendarDB* calDB, QObject* parent)
+    : QAbstractListModel(parent)
+{
+    assert(calDB);
+    _calDB = calDB;
+    _dirtyFirst = -1;
+    _dirtyLast = -1;
+    _onlineCount = 0;
+    _reportedAllOnline = true;
+    connect(_calDB, SIGNAL(newCalendarAdded(int)), this, SLOT(addCalendar(int)));
+    connect(_calDB, SIGNAL(removingCalendar(int)), this, SLOT(removeCalendar(int)));
+
+    _flushTimer.setSingleShot(true);
+    _flushTimer.setInterval(FLUSHINTERVAL);
+    connect(&_flushTimer, SIGNAL(timeout()), this, SLOT(flush()));
+}
+
+int CalendarListModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : _rows.size();
+}
+
+QVariant CalendarListModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= _rows.size())
+        return QVariant();
+
+    const Row& row = _rows.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        return row.label;
+    case Qt::DecorationRole: {
+        Calendar* cal = _calDB->calendar(row.id);
+        if (!cal)
+            return QVariant();
+        return PixmapCache::instance()->calendarIcon(cal, ICONSIZE, 1, QColor(0, 0, 0));
+    }
+    case Qt::UserRole:
+        return row.id;
+    default:
+        return QVariant();
+    }
+}
+
+void CalendarListModel::refreshRow(Row& row) {
+    Calendar* cal = _calDB->calendar(row.id);
+    assert(cal);
+
+    Calendar::StatusCode status = cal->status();
+    QString statusName;
+    switch (status) {
+    default:
+    case Calendar::NotLoaded:
+        statusName = "not loaded";
+        break;
+    case Calendar::Online:
+        statusName = "online";
+        break;
+    case Calendar::Offline:
+        statusName = "offline";
+        break;
+    }
+    row.label = cal->name() + " (" + statusName + ")";
+
+    // Keep the online counter in sync
+    if (row.status == Calendar::Online && status != Calendar::Online)
+        --_onlineCount;
+    else if (row.status != Calendar::Online && status == Calendar::Online)
+        ++_onlineCount;
+    row.status = status;
+    row.dirty = false;
+}
+
+void CalendarListModel::reportAllOnline() {
+    if (allOnline() == _reportedAllOnline)
+        return;
+
+    _reportedAllOnline = allOnline();
+    emit allOnlineChanged(_reportedAllOnline);
+}
+
+void CalendarListModel::addCalendar(int id) {
+    Calendar* cal = _calDB->calendar(id);
+    assert(cal);
+    connect(cal, SIGNAL(nameChanged(int)), this, SLOT(markDirty(int)));
+    connect(cal, SIGNAL(statusChanged(int)), this, SLOT(markDirty(int)));
+
+    Row row;
+    row.id = id;
+    refreshRow(row);
+
+    int rowNum = _rows.size();
+    beginInsertRows(QModelIndex(), rowNum, rowNum);
+    _rows.append(row);
+    _rowById.insert(id, rowNum);
+    endInsertRows();
+    reportAllOnline();
+}
+
+void CalendarListModel::removeCalendar(int id) {
+    QHash<int, int>::iterator it = _rowById.find(id);
+    assert(it != _rowById.end());
+    int rowNum = *it;
+
+    beginRemoveRows(QModelIndex(), rowNum, rowNum);
+    if (_rows.at(rowNum).status == Calendar::Online)
+        --_onlineCount;
+    _rows.remove(rowNum);
+    _rowById.erase(it);
+    for (int i = rowNum; i < _rows.size(); ++i)
+        _rowById[_rows.at(i).id] = i;
+    endRemoveRows();
+    PixmapCache::instance()->removeCalendar(id);
+
+    // Pending changes below the removed row moved up one row
+    if (_dirtyFirst > rowNum)
+        --_dirtyFirst;
+    if (_dirtyLast >= rowNum)
+        --_dirtyLast;
+    if (_dirtyLast < _dirtyFirst)
+        _dirtyFirst = _dirtyLast = -1;
+    reportAllOnline();
+}
+
+void CalendarListModel::markDirty(int id) {
+    // Calendars post their signals from their own thread, so a removed
+    // calendar's last signals may still arrive after removeCalendar
+    QHash<int, int>::const_iterator it = _rowById.find(id);
+    if (it == _rowById.end())
+        return;
+
+    _rows[*it].dirty = true;
+    if (_dirtyFirst < 0) {
+        _dirtyFirst = _dirtyLast = *it;
+        _flushTimer.start();
+    } else {
+        _dirtyFirst = std::min(_dirtyFirst, *it);
+        _dirtyLast = std::max(_dirtyLast, *it);
+    }
+}
+
+void CalendarListModel::flush() {
+    if (_dirtyFirst < 0)
+        return;
+
+    // A single range keeps the view from repainting row by row
+    for (int i = _dirtyFirst; i <= _dirtyLast; ++i) {
+        if (_rows.at(i).dirty)
+            refreshRow(_rows[i]);
+    }
+    LOG_TRACE(CLASSNAME, this, LogMessage("Flushing rows %1 to %2").arg(_dirtyFirst).arg(_dirtyLast));
+    emit dataChanged(index(_dirtyFirst), index(_dirtyLast));
+
+    _dirtyFirst = _dirtyLast = -1;
+    reportAllOnline();
+}
@@ -0,0 +1,86 @@
+#ifndef CALENDARLISTMODEL_H
+#define CALENDARLISTMODEL_H
+
+#include "model/logger.h"
+#include "model/calendar.h"
+#include <QHash>
+#include <QTimer>
+#include <QString>
+#include <QVector>
+#include <QAbstractListModel>
+class CalendarDB;
+
+/**
+  * List model over the calendars of a CalendarDB, in the order they were added.
+  * The label of each calendar is cached: name and status changes only mark a row
+  * as dirty. Dirty rows are refreshed together once per frame, with a single
+  * dataChanged() covering all of them. The model also counts the calendars that
+  * are online, so the "all calendars online?" state costs nothing to keep up to
+  * date. Only to be used from the GUI thread.
+  * \author Pieter De Decker
+  */
+class CalendarListModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    CalendarListModel(CalendarDB* calDB, QObject* parent = 0);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+
+    /** Returns the ID of the calendar in a row. */
+    int idAt(int row) const { return _rows.at(row).id; }
+
+    /** Returns true if every calendar is online. */
+    bool allOnline() const { return _onlineCount == _rows.size(); }
+
+    /** Height of the calendar icons in pixels. */
+    static const int ICONSIZE;
+
+    /** How long (ms) changes are collected before the view hears about them. */
+    static const int FLUSHINTERVAL;
+private:
+    static LogCategory CLASSNAME;
+
+    struct Row {
+        Row() : id(-1), status(Calendar::NotLoaded), dirty(false) {}
+
+        int id;
+        QString label;
+        Calendar::StatusCode status;
+        bool dirty;
+    };
+
+    /** Reads the name and status of a calendar into its row and keeps the online
+      * counter in sync. */
+    void refreshRow(Row& row);
+
+    /** Emits allOnlineChanged if the aggregate state differs from the last one reported. */
+    void reportAllOnline();
+
+    CalendarDB* _calDB;
+    QVector<Row> _rows;
+    QHash<int, int> _rowById;
+
+    /** Range holding all rows that changed since the last flush. */
+    int _dirtyFirst;
+    int _dirtyLast;
+    QTimer _flushTimer;
+
+    int _onlineCount;
+    bool _reportedAllOnline;
+private slots:
+    void addCalendar(int id);
+    void removeCalendar(int id);
+
+    /** Marks the row of a calendar as dirty and schedules a flush. */
+    void markDirty(int id);
+
+    /** Refreshes all dirty rows and tells the view about them. */
+    void flush();
+signals:
+    /** Broadcast when all calendars come online, or when one of them no longer is. */
+    void allOnlineChanged(bool allOnline);
+};
+
+#endif // CALENDARLISTMODEL_H
@@ -0,0 +1,97 @@
+#include "pixmapcache.h"
+
+#include "model/calendar.h"
+#include <cassert>
+#include <algorithm>
+
+PixmapCache PixmapCache::instancePtr;
+const int PixmapCache::IMAGEDIM = 64;
+
+uint qHash(const PixmapCache::IconKey& key) {
+    return uint(key.calendarId) * 31u * 31u * 31u + uint(key.height) * 31u * 31u
+            + uint(key.borderThickness) * 31u + uint(key.borderColor);
+}
+
+PixmapCache::PixmapCache()
+{
+}
+
+PixmapCache* PixmapCache::instance() {
+    return &instancePtr;
+}
+
+const QPixmap& PixmapCache::calendarIcon(Calendar* cal, int height, int borderThickness, const QColor& borderColor) {
+    assert(cal);
+    Icon& icon = _icons[IconKey(cal->id(), height, borderThickness, borderColor.rgb())];
+
+    // Build on first use, and again if the calendar got a different color
+    QColor calColor(cal->color());
+    if (icon.pixmap.isNull() || icon.calendarColor != calColor.rgb()) {
+        QImage img = buildCalendarImage(calColor).scaledToHeight(height);
+        drawBorder(img, borderThickness, borderColor);
+        icon.calendarColor = calColor.rgb();
+        icon.pixmap = QPixmap::fromImage(img);
+    }
+
+    return icon.pixmap;
+}
+
+const QPixmap& PixmapCache::resource(const QString& path) {
+    QHash<QString, QPixmap>::iterator it = _resources.find(path);
+    if (it == _resources.end())
+        it = _resources.insert(path, QPixmap(path));
+
+    return *it;
+}
+
+void PixmapCache::removeCalendar(int id) {
+    for (QHash<IconKey, Icon>::iterator it = _icons.begin(); it != _icons.end(); ) {
+        if (it.key().calendarId == id)
+            it = _icons.erase(it);
+        else
+            ++it;
+    }
+}
+
+void PixmapCache::clear() {
+    _icons.clear();
+    _resources.clear();
+}
+
+QImage PixmapCache::buildCalendarImage(const QColor& color)
+{
+    QImage img(IMAGEDIM, IMAGEDIM, QImage::Format_RGB32);
+
+    // Create gradient
+    for (unsigned row = 0; row < (unsigned)IMAGEDIM; ++row) {
+        QRgb* curline = (QRgb*)img.scanLine(row);
+
+        for (unsigned col = 0; col < (unsigned)IMAGEDIM; ++col) {
+            QColor newColor = color;
+            newColor.setRed(std::min(newColor.red() + ((double)(IMAGEDIM - row)/IMAGEDIM)*75, (double)255));
+            newColor.setGreen(std::min(newColor.green() + ((double)(IMAGEDIM - row)/IMAGEDIM)*75, (double)255));
+            newColor.setBlue(std::min(newColor.blue() + ((double)(IMAGEDIM - row)/IMAGEDIM)*75, (double)255));
+
+            curline[col] = newColor.rgb();
+        }
+    }
+
+    return img;
+}
+
+void PixmapCache::drawBorder(QImage &img, int thickness, const QColor &color) {
+    assert(thickness < img.width() && thickness < img.height());
+    fillRectangle(img, 0, 0, img.width(), thickness, color);                               // Top
+    fillRectangle(img, img.width() - thickness, 0, thickness, img.height(), color);        // Right
+    fillRectangle(img, 0, img.height() - thickness, img.width(), thickness, color);        // Bottom
+    fillRectangle(img, 0, 0, thickness, img.height(), color);                              // Left
+}
+
+void PixmapCache::fillRectangle(QImage &img, unsigned x, unsigned y, unsigned w, unsigned h, const QColor& color) {
+    for (unsigned row = y; row < y + h; ++row) {
+        QRgb* curline = (QRgb*)img.scanLine(row);
+
+        for (unsigned col = x; col < x + w; ++col)
+            curline[col] = color.rgb();
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef PIXMAPCACHE_H
+#define PIXMAPCACHE_H
+
+#include <QRgb>
+#include <QHash>
+#include <QColor>
+#include <QImage>
+#include <QPixmap>
+#include <QString>
+class Calendar;
+
+/**
+  * Process-wide cache for the pixmaps the view paints over and over: calendar
+  * icons at a given size and border, and images from the resource system. Each
+  * pixmap is decoded or scaled once; calendar icons are only rebuilt when the
+  * calendar's color changes. Pixmaps can only be used on the GUI thread, and so
+  * can this class.
+  * \author Pieter De Decker
+  */
+class PixmapCache
+{
+private:
+    PixmapCache();
+public:
+    static PixmapCache* instance();
+
+    /** Returns the image of 'cal' scaled to 'height' pixels with a border of
+      * 'borderThickness' pixels in 'borderColor'. */
+    const QPixmap& calendarIcon(Calendar* cal, int height, int borderThickness, const QColor& borderColor);
+
+    /** Returns the image at 'path', which is usually a ":/" resource path. */
+    const QPixmap& resource(const QString& path);
+
+    /** Drops all icons of the calendar with this ID. */
+    void removeCalendar(int id);
+
+    /** Drops everything. Must be called before the QApplication goes away. */
+    void clear();
+
+    /** Draws a border around an image. Since icons are resized often, the border
+      * has to be added after scaling. */
+    static void drawBorder(QImage& img, int thickness, const QColor& color);
+
+    /** Size of the full-resolution calendar images that icons are scaled from. */
+    static const int IMAGEDIM;
+private:
+    struct IconKey {
+        IconKey(int i, int h, int t, QRgb b) : calendarId(i), height(h), borderThickness(t), borderColor(b) {}
+        bool operator==(const IconKey& other) const {
+            return calendarId == other.calendarId && height == other.height
+                    && borderThickness == other.borderThickness && borderColor == other.borderColor;
+        }
+
+        int calendarId;
+        int height;
+        int borderThickness;
+        QRgb borderColor;
+    };
+
+    struct Icon {
+        QRgb calendarColor;
+        QPixmap pixmap;
+    };
+
+    friend uint qHash(const IconKey& key);
+
+    /** Creates the full-resolution image for a calendar color: a vertical gradient. */
+    static QImage buildCalendarImage(const QColor& color);
+
+    /** Fills a rectangle area in an image with a color. */
+    static void fillRectangle(QImage& img, unsigned x, unsigned y, unsigned w, unsigned h, const QColor& color);
+
+    static PixmapCache instancePtr;
+
+    QHash<IconKey, Icon> _icons;
+    QHash<QString, QPixmap> _resources;
+};
+
+#endif // PIXMAPCACHE_H
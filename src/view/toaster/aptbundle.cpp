@@ -1,9 +1,13 @@
 #include "aptbundle.h"
 
-#include "model/calendar.h"
-
-AptBundle::AptBundle(Calendar* cal, const QString& title, const QList<Appointment>& list) {
-    _cal = cal;
+AptBundle::AptBundle(int calendarId, const QString& title, const QList<Appointment>& list) {
+    _calendarId = calendarId;
     _title = title;
     _list = list;
 }
+
+AptBundle::AptBundle(const QString& title, const QString& summary) {
+    _calendarId = -1;
+    _title = title;
+    _summary = summary;
+}
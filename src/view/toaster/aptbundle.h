@@ -4,27 +4,38 @@
 #include "model/appointment.h"
 #include <QString>
 #include <QLinkedList>
-class Calendar;
 
 /**
   * Structure that assists in sending lists of
   * "Event Reminder" or "Happening Now" appointments
-  * to an active toaster.
+  * to an active toaster. Calendars are referred to by ID,
+  * since they may be removed while the bundle is queued.
+  * A summary bundle holds a single line of text instead,
+  * and no calendar.
   * \author Pieter De Decker
   */
 class AptBundle
 {
 public:
-    AptBundle(Calendar* cal, const QString& title, const QList<Appointment>& list);
+    AptBundle(int calendarId, const QString& title, const QList<Appointment>& list);
+
+    /** Creates a summary bundle. */
+    AptBundle(const QString& title, const QString& summary);
 
     /* Getters */
-    Calendar* cal() const { return _cal; }
+    int calendarId() const { return _calendarId; }
     const QString& title() const { return _title; }
     const QList<Appointment>& list() const { return _list; }
+    bool isSummary() const { return _calendarId < 0; }
+    const QString& summary() const { return _summary; }
+
+    /** Number of slides this bundle takes up in a toaster. */
+    int slideCount() const { return isSummary() ? 1 : _list.size(); }
 private:
-    Calendar* _cal;
+    int _calendarId;
     QString _title;
     QList<Appointment> _list;
+    QString _summary;
 };
 
 #endif // APPOINTMENTBUNDLE_H
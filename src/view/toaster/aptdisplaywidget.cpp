@@ -2,6 +2,7 @@
 
 #include "model/calendar.h"
 #include "model/appointment.h"
+#include "view/pixmapcache.h"
 
 AptDisplayWidget::AptDisplayWidget(QWidget* parent) :
     QWidget(parent) {
@@ -15,10 +16,22 @@ void AptDisplayWidget::loadAppointment(Calendar* cal, const Appointment& apt)
     _lblAppointment.setText("<b style='font-size: 16px; font-family: Arial'>" + apt.summary() + "</b><br />" + timeStr);
 
     // Calendar info
-    QImage calImg = cal->image().scaledToHeight(14);
-    Calendar::drawBorder(calImg, 1, QColor(25, 25, 25));
-    _lblCalImg.setPixmap(QPixmap::fromImage(calImg));
+    if (!cal) {
+        _lblCalImg.hide();
+        _lblCalName.hide();
+        return;
+    }
+    _lblCalImg.setPixmap(PixmapCache::instance()->calendarIcon(cal, 14, 1, QColor(25, 25, 25)));
     _lblCalName.setText(cal->name());
+    _lblCalImg.show();
+    _lblCalName.show();
+}
+
+void AptDisplayWidget::loadSummary(const QString& summary)
+{
+    _lblAppointment.setText("<b style='font-size: 16px; font-family: Arial'>" + summary + "</b>");
+    _lblCalImg.hide();
+    _lblCalName.hide();
 }
 
 void AptDisplayWidget::setupGUI() {
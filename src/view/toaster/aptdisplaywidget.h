@@ -15,8 +15,12 @@ class AptDisplayWidget : public QWidget
 public:
     AptDisplayWidget(QWidget* parent = 0);
     
-    /** Displays an appointment from a certain calendar in this widget. */
+    /** Displays an appointment from a certain calendar in this widget. If 'cal' is
+      * NULL, because the calendar was removed, the calendar info is left out. */
     void loadAppointment(Calendar* cal, const Appointment& apt);
+
+    /** Displays a line of text instead of an appointment, without a calendar. */
+    void loadSummary(const QString& summary);
 private:
     /** Hooks up all widgets. */
     void setupGUI();
@@ -1,19 +1,21 @@
 #include "toaster.h"
 
 #include "model/logger.h"
+#include "model/calendarregistry.h"
+#include "view/pixmapcache.h"
 #include <QFont>
 #include <cassert>
 #include <QPainter>
 #include <QSpacerItem>
 
-const char* Toaster::CLASSNAME = "Toaster";
+LogCategory Toaster::CLASSNAME("Toaster");
 
-Toaster::Toaster()
+Toaster::Toaster(const CalendarRegistry* calendars)
     : QDialog(NULL)
 {
-    _curAptID = 0;
-    _curBundle = 0;
-    _curApt = -1;
+    assert(calendars);
+    _calendars = calendars;
+    _curSlide = -1;
     setupGUI();
 }
 
@@ -21,9 +23,18 @@ Toaster::~Toaster() {
 }
 
 void Toaster::appendBundle(const AptBundle& bundle) {
-    assert(bundle.list().size() > 0);
+    assert(bundle.slideCount() > 0);
+    int bundleID = _bundles.size();
     _bundles.append(bundle);
-    _lblCounter.setText(QString::number(_curAptID) + "/" + QString::number(totalApts()));
+
+    // Index every appointment so navigation never has to walk the bundles
+    int count = bundle.slideCount();
+    _slides.reserve(_slides.size() + count);
+    for (int i = 0; i < count; ++i)
+        _slides.append(Slide(bundleID, i));
+
+    updateCounter();
+    _btnNext.setEnabled(_curSlide + 1 < _slides.size());
 }
 
 void Toaster::setupGUI() {
@@ -67,97 +78,55 @@ void Toaster::setupGUI() {
     _slideTimer.setInterval(5000);
 }
 
-int Toaster::totalApts() const {
-    int total = 0;
-    foreach (AptBundle bundle, _bundles) {
-        total += bundle.list().size();
-    }
-
-    return total;
+void Toaster::updateCounter() {
+    _lblCounter.setText(QString::number(_curSlide + 1) + "/" + QString::number(_slides.size()));
 }
 
 void Toaster::loadAppointment() {
-    Logger::instance()->add(CLASSNAME, this, "Loading slide (" + QString::number(_curBundle) + ", " + QString::number(_curApt) + ")...");
-
-    assert(exists(_curBundle, _curApt));
-    AptBundle aptBundle = _bundles.at(_curBundle);
-    Appointment apt = aptBundle.list().at(_curApt);
+    assert(_curSlide >= 0 && _curSlide < _slides.size());
+    const Slide& slide = _slides.at(_curSlide);
+    LOG_DEBUG(CLASSNAME, this, LogMessage("Loading slide %1 (%2, %3)...").arg(_curSlide).arg(slide.bundle).arg(slide.apt));
+    const AptBundle& aptBundle = _bundles.at(slide.bundle);
 
     // Set the new title and pass the appointment to the display widget
     _lblTitle.setText(aptBundle.title());
-    _lblCounter.setText(QString::number(_curAptID) + "/" + QString::number(totalApts()));
-    _adg.loadAppointment(aptBundle.cal(), apt);
-
-    // Enable previous button?
-    if (exists(_curBundle - 1, 0) || exists(_curBundle, _curApt - 1))
-        _btnPrev.setEnabled(true);
+    updateCounter();
+    if (aptBundle.isSummary())
+        _adg.loadSummary(aptBundle.summary());
     else
-        _btnPrev.setEnabled(false);
+        _adg.loadAppointment(_calendars->find(aptBundle.calendarId()), aptBundle.list().at(slide.apt));
 
-    // Enable next button?
-    if (exists(_curBundle + 1, 0) || exists(_curBundle, _curApt + 1))
-        _btnNext.setEnabled(true);
-    else
-        _btnNext.setEnabled(false);
-}
-
-bool Toaster::exists(int bundleID, int aptID) {
-    if (bundleID >= _bundles.size() || bundleID < 0 || aptID < 0)
-        return false;
-    const AptBundle& bundle = _bundles.at(bundleID);
-    return aptID < bundle.list().size();
+    // Enable previous and next buttons?
+    _btnPrev.setEnabled(_curSlide > 0);
+    _btnNext.setEnabled(_curSlide + 1 < _slides.size());
 }
 
 void Toaster::prevSlide() {
-    Logger::instance()->add(CLASSNAME, this, "Loading previous slide...");
+    LOG_DEBUG(CLASSNAME, this, "Loading previous slide...");
 
-    if (_curAptID <= 0) {
-        Logger::instance()->add(CLASSNAME, this, "Can't go back any further");
+    if (_curSlide <= 0) {
+        LOG_DEBUG(CLASSNAME, this, "Can't go back any further");
         return;
     }
     _slideTimer.stop();
 
-    // Try to go to the previous appointment in this bundle
-    if (_curApt > 0) {
-        --_curApt;
-        assert(exists(_curBundle, _curApt));
-    }
-    // Or else go to the last appointment in the previous bundle
-    else {
-        assert(_curBundle > 0);
-        --_curBundle;
-        _curApt = _bundles.at(_curBundle).list().size() - 1;
-        assert(exists(_curBundle, _curApt));
-    }
-
-    --_curAptID;
+    --_curSlide;
     loadAppointment();
     _slideTimer.start();
 }
 
 void Toaster::nextSlide() {
-    Logger::instance()->add(CLASSNAME, this, "Loading next slide");
+    LOG_DEBUG(CLASSNAME, this, "Loading next slide");
     _slideTimer.stop();
 
     // Send close request if no next slide is available
-    if (_curAptID >= totalApts()) {
-        Logger::instance()->add(CLASSNAME, this, "Finished showing slides");
+    if (_curSlide + 1 >= _slides.size()) {
+        LOG_DEBUG(CLASSNAME, this, "Finished showing slides");
         emit closeRequested(this);
         return;
     }
 
-    // Try to go to the next appointment in this bundle
-    if (exists(_curBundle, _curApt + 1)) {
-        ++_curApt;
-    }
-    // Or else go to the first appointment in the next bundle
-    else {
-        ++_curBundle;
-        _curApt = 0;
-        assert(exists(_curBundle, _curApt));
-    }
-
-    ++_curAptID;
+    ++_curSlide;
     loadAppointment();
     _slideTimer.start();
 }
@@ -166,11 +135,11 @@ void Toaster::paintEvent(QPaintEvent* event) {
     QDialog::paintEvent(event);
 
     QPainter painter(this);
-    painter.drawImage(0, 0, QImage(":/bg/toaster.png"));
+    painter.drawPixmap(0, 0, PixmapCache::instance()->resource(":/bg/toaster.png"));
 
-    if (_curBundle == 0 && _curApt == -1) {
+    if (_curSlide == -1) {
         nextSlide();
         _slideTimer.start();
-        Logger::instance()->add(CLASSNAME, this, "Starting cycle timer");
+        LOG_DEBUG(CLASSNAME, this, "Starting cycle timer");
     }
 }
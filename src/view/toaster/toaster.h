@@ -2,49 +2,66 @@
 #define TOASTER_H
 
 #include "aptbundle.h"
+#include "model/logger.h"
 #include "aptdisplaywidget.h"
 #include <QLabel>
 #include <QTimer>
 #include <QString>
 #include <QDialog>
+#include <QVector>
 #include <QPushButton>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QLinkedList>
+class CalendarRegistry;
 
 /**
   * General purpose notification window. This class is NOT thread-safe.
+  *
+  * Appended bundles are never modified, and every appointment in them gets an
+  * entry in a flat slide index. Moving between slides, counting them and
+  * appending a bundle therefore don't depend on how many slides are queued.
   * \author Pieter De Decker
   */
 class Toaster : public QDialog
 {
     Q_OBJECT
 public:
-    Toaster();
+    /** Bundles refer to calendars by ID; they're looked up in 'calendars' when
+      * their slides are shown. */
+    Toaster(const CalendarRegistry* calendars);
     ~Toaster();
 
     /** Adds new appointments to this toaster. */
     void appendBundle(const AptBundle& bundle);
 
+    /** Number of slides that haven't been shown yet. */
+    int pendingSlides() const { return _slides.size() - _curSlide - 1; }
+
     static const int WIDTH = 350;
     static const int HEIGHT = 150;
     static const int BORDERSPACING = 10;
 private:
-    static const char* CLASSNAME;
+    static LogCategory CLASSNAME;
 
     /** Hooks up all widgets. */
     void setupGUI();
 
-    /** Calculates the total number of appointments in the queue. */
-    int totalApts() const;
-
-    /** Loads the appointment from (bundle ID, appointment ID) into the toaster.
-      * The accompanying title and calendar indicator are also updated. */
+    /** Loads the appointment of the current slide into the toaster. The
+      * accompanying title and calendar indicator are also updated. */
     void loadAppointment();
 
-    /** Returns true if a bundle with ID 'bundleID' exists *and* this bundle
-      * holds an appointment with ID 'aptID'. */
-    bool exists(int bundleID, int aptID);
+    /** Updates the "current/total" label. */
+    void updateCounter();
+
+    /** Position of one appointment in _bundles. */
+    struct Slide {
+        Slide() : bundle(0), apt(0) {}
+        Slide(int b, int a) : bundle(b), apt(a) {}
+
+        int bundle;
+        int apt;
+    };
 
     // Widgets and layouts
     QLabel _lblTitle;
@@ -57,11 +74,11 @@ private:
     QVBoxLayout _vlInfo;
     QHBoxLayout _hlBottom;
 
+    const CalendarRegistry* _calendars;
     QTimer _slideTimer;
-    QList<AptBundle> _bundles;
-    int _curBundle;
-    int _curApt;
-    int _curAptID;
+    QList<AptBundle> _bundles;      // Append-only; bundles share their appointment lists
+    QVector<Slide> _slides;
+    int _curSlide;                  // -1 until the first slide is shown
 private slots:
     /** Advances to the previous slide. If unavailable, does nothing. */
     void prevSlide();
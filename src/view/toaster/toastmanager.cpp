@@ -2,16 +2,26 @@
 
 #include "aptbundle.h"
 #include "model/logger.h"
+#include "model/metrics.h"
 #include "model/calendar.h"
+#include "model/flightrecorder.h"
 #include "view/toaster/toaster.h"
 #include <cassert>
 #include <QThread>
 #include <QApplication>
 #include <QDesktopWidget>
 
-const char* ToastManager::CLASSNAME = "ToastManager";
+LogCategory ToastManager::CLASSNAME("ToastManager");
 
-ToastManager::ToastManager() {
+namespace {
+    Counter toastersMetric("aptnotifier_toasters_total", "Toasters that popped up");
+    Counter slidesMetric("aptnotifier_toast_slides_total", "Slides queued in toasters");
+    Gauge queueMetric("aptnotifier_toast_queue_depth", "Slides waiting in the active toaster, as of the last change to the queue");
+}
+
+ToastManager::ToastManager(const CalendarRegistry* calendars) {
+    assert(calendars);
+    _calendars = calendars;
     _toaster = NULL;
 }
 
@@ -22,30 +32,46 @@ ToastManager::~ToastManager() {
 
 void ToastManager::addToQueue(Calendar *cal, const QString &title, const QList<Appointment>& list) {
     assert(isGUIThread());
+    FlightRecorder::instance()->record(FlightRecorder::ToastQueued, cal, list.size());
+    LOG_DEBUG(CLASSNAME, NULL, LogMessage("Queueing toaster content '%1' for calendar %2...").arg(title).arg(cal->name()));
+    enqueue(AptBundle(cal->id(), title, list));
+}
 
+void ToastManager::addSummaryToQueue(const QString& title, const QString& summary) {
+    assert(isGUIThread());
+    FlightRecorder::instance()->record(FlightRecorder::ToastQueued, NULL, 1);
+    LOG_DEBUG(CLASSNAME, NULL, LogMessage("Queueing toaster summary '%1'...").arg(summary));
+    enqueue(AptBundle(title, summary));
+}
+
+void ToastManager::enqueue(const AptBundle& bundle) {
     // Spawn new toaster
     if (!_toaster) {
-        Logger::instance()->add(CLASSNAME, "Creating new toaster with content '" + title + "' for calendar " + cal->name() + "...");
-        _toaster = new Toaster();
+        LOG_DEBUG(CLASSNAME, NULL, "Creating new toaster...");
+        toastersMetric.add();
+        _toaster = new Toaster(_calendars);
         connect(_toaster, SIGNAL(closeRequested(Toaster*)), this, SLOT(closeToaster(Toaster*)));
         QDesktopWidget* qdw = QApplication::desktop();
         _toaster->setGeometry(qdw->availableGeometry().width() - Toaster::WIDTH,
                     qdw->availableGeometry().height() - Toaster::HEIGHT,
                     Toaster::WIDTH, Toaster::HEIGHT);
-        _toaster->appendBundle(AptBundle(cal, title, list));
+        _toaster->appendBundle(bundle);
         _toaster->show();
     }
     // Add notifications to existing toaster
     else {
-        Logger::instance()->add(CLASSNAME, "Adding toaster content '" + title + "' for calendar " + cal->name() + "...");
-        _toaster->appendBundle(AptBundle(cal, title, list));
+        _toaster->appendBundle(bundle);
     }
+
+    slidesMetric.add(bundle.slideCount());
+    queueMetric.set(_toaster->pendingSlides());
 }
 
 void ToastManager::closeToaster(Toaster* toast) {
     assert(toast == _toaster);
     delete _toaster;
     _toaster = NULL;
+    queueMetric.set(0);
 }
 
 bool ToastManager::isGUIThread() {
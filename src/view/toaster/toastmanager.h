@@ -1,6 +1,7 @@
 #ifndef TOASTMANAGER_H
 #define TOASTMANAGER_H
 
+#include "model/logger.h"
 #include "model/appointment.h"
 #include <QMap>
 #include <QMutex>
@@ -8,6 +9,8 @@
 #include <QLinkedList>
 class Toaster;
 class Calendar;
+class AptBundle;
+class CalendarRegistry;
 
 /**
   * Manages all active toaster notifications. Member functions in
@@ -20,13 +23,17 @@ class ToastManager : public QObject
 {
     Q_OBJECT
 public:
-    ToastManager();
+    /** Toasters look calendars up in 'calendars' when they show their slides. */
+    ToastManager(const CalendarRegistry* calendars);
     ~ToastManager();
 
     /** Adds appointment list to the notification queue.
       * If no toaster is active, a new toaster will pop up. Otherwise
       * the list will be appended in the active toaster. */
     void addToQueue(Calendar* cal, const QString& title, const QList<Appointment>& list);
+
+    /** Adds a single line of text to the notification queue, in the same way. */
+    void addSummaryToQueue(const QString& title, const QString& summary);
 private slots:
     /** Catches a close signal from an active toaster and de-allocates it in
       * response to this signal. */
@@ -35,8 +42,12 @@ private:
     /** Returns true if this function is being executed on the GUI thread. */
     bool isGUIThread();
 
-    static const char* CLASSNAME;
+    /** Shows 'bundle' in the active toaster, or in a new one if there is none. */
+    void enqueue(const AptBundle& bundle);
+
+    static LogCategory CLASSNAME;
 
+    const CalendarRegistry* _calendars;
     Toaster* _toaster;
 };
 